@@ -187,3 +187,98 @@ function updateAnglePlot(currentAngle, targetAngle) {
         angleChart.update();
     }
 }
+
+// Step-response overlay: the last few runs drawn on shared axes, relative to the pre-step baseline
+const STEP_MAX_RUNS = 5;
+const STEP_COLORS = ['#4bc0c0', '#ff6384', '#36a2eb', '#ff9f40', '#9966ff'];
+let stepRuns = [];
+
+function stepRunColor(run) {
+    return STEP_COLORS[run % STEP_COLORS.length];
+}
+
+function startStepRun(run) {
+    stepRuns.push({ run: run, t: [], angle: [], setpoint: [] });
+    if (stepRuns.length > STEP_MAX_RUNS) {
+        stepRuns.shift();
+    }
+}
+
+function addStepTrace(chunk) {
+    const run = stepRuns.find(r => r.run === chunk.run);
+    if (!run) return;
+    run.t.push(...chunk.t);
+    run.angle.push(...chunk.angle);
+    run.setpoint.push(...chunk.setpoint);
+    if (chunk.last) {
+        drawStepRuns();
+    }
+}
+
+function clearStepRuns() {
+    stepRuns = [];
+    document.getElementById('stepResults').innerHTML = '';
+    drawStepRuns();
+}
+
+function drawStepRuns() {
+    const canvas = document.getElementById('stepChart');
+    const ctx = canvas.getContext('2d');
+    const width = canvas.width;
+    const height = canvas.height;
+
+    ctx.fillStyle = '#ffffff';
+    ctx.fillRect(0, 0, width, height);
+    if (stepRuns.length === 0) return;
+
+    // Shared axes over every run
+    let tMin = 0, tMax = 0, yMin = -0.5, yMax = 0.5;
+    stepRuns.forEach(r => {
+        tMin = Math.min(tMin, ...r.t);
+        tMax = Math.max(tMax, ...r.t);
+        yMin = Math.min(yMin, ...r.angle, ...r.setpoint);
+        yMax = Math.max(yMax, ...r.angle, ...r.setpoint);
+    });
+    const margin = (yMax - yMin) * 0.1;
+    yMin -= margin;
+    yMax += margin;
+
+    const x = t => 50 + (t - tMin) / Math.max(tMax - tMin, 1) * (width - 60);
+    const y = v => height - 30 - (v - yMin) / (yMax - yMin) * (height - 50);
+
+    // Zero line and the step instant
+    ctx.strokeStyle = '#e0e0e0';
+    ctx.lineWidth = 1;
+    ctx.beginPath();
+    ctx.moveTo(50, y(0));
+    ctx.lineTo(width - 10, y(0));
+    ctx.moveTo(x(0), 20);
+    ctx.lineTo(x(0), height - 30);
+    ctx.stroke();
+
+    ctx.fillStyle = '#666';
+    ctx.font = '10px Arial';
+    ctx.textAlign = 'right';
+    ctx.fillText(yMax.toFixed(2) + '°', 45, 25);
+    ctx.fillText(yMin.toFixed(2) + '°', 45, height - 30);
+    ctx.textAlign = 'center';
+    ctx.fillText(tMin + ' ms', 50, height - 10);
+    ctx.fillText(tMax + ' ms', width - 20, height - 10);
+
+    stepRuns.forEach(r => {
+        const color = stepRunColor(r.run);
+        ctx.lineWidth = 2;
+        ctx.strokeStyle = color;
+        ctx.setLineDash([]);
+        ctx.beginPath();
+        r.t.forEach((t, i) => i === 0 ? ctx.moveTo(x(t), y(r.angle[i])) : ctx.lineTo(x(t), y(r.angle[i])));
+        ctx.stroke();
+
+        ctx.lineWidth = 1;
+        ctx.setLineDash([4, 4]);
+        ctx.beginPath();
+        r.t.forEach((t, i) => i === 0 ? ctx.moveTo(x(t), y(r.setpoint[i])) : ctx.lineTo(x(t), y(r.setpoint[i])));
+        ctx.stroke();
+    });
+    ctx.setLineDash([]);
+}
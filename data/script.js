@@ -1,6 +1,6 @@
 // script.js - JavaScript for Robot Control Interface with WebSocket
 
-let statusInterval;
+let robotStatus = {};
 let currentPID = { kp: 0.0, ki: 0.0, kd: 0.0 };
 let currentTargetAngle = 90.0;
 let ws;
@@ -9,9 +9,9 @@ let consoleElement;
 // Initialize the page
 window.onload = function() {
     setupEventListeners();
-    statusInterval = setInterval(updateStatus, 5000); // Update status every 5 seconds
     initWebSocket();
     initAngleChart();
+    initJoystick();
 };
 
 // Initialize WebSocket connection
@@ -22,11 +22,18 @@ function initWebSocket() {
     ws.onopen = function(event) {
         console.log('WebSocket connected');
         consoleElement.textContent = 'WebSocket connected. Waiting for serial data...\n';
+        // Subscribe to the streams this page draws
+        ws.send(JSON.stringify({type: "subscribe", stream: "tilt", rate: 10}));
+        ws.send(JSON.stringify({type: "subscribe", stream: "console", rate: 1}));
+        ws.send(JSON.stringify({type: "subscribe", stream: "metrics", rate: 1}));
+        ws.send(JSON.stringify({type: "subscribe", stream: "latency", rate: 1}));
+        sendPing();
         // Request current buffer
         ws.send('get-buffer');
         // Request current PID values
         ws.send(JSON.stringify({type: "get-pid"}));
         ws.send(JSON.stringify({type: "get-target-angle"}));
+        ws.send(JSON.stringify({type: "profile-list"}));
     };
 
     ws.onmessage = function(event) {
@@ -35,6 +42,12 @@ function initWebSocket() {
             const jsonData = JSON.parse(data);
             if (jsonData.type === 'angle') {
                 updateAnglePlot(jsonData.current, jsonData.target);
+                recordTelemetryAge(jsonData.t);
+            } else if (jsonData.type === 'pong') {
+                handlePong(jsonData);
+            } else if (jsonData.type === 'latency') {
+                robotLatency = jsonData;
+                renderLatency();
             } else if (jsonData.type === 'pid-values') {
                 currentPID.kp = jsonData.kp;
                 currentPID.ki = jsonData.ki;
@@ -46,6 +59,24 @@ function initWebSocket() {
                 } else {
                     alert('Failed to update PID values: ' + (jsonData.message || 'Unknown error'));
                 }
+            } else if (jsonData.type === 'status') {
+                // Deltas: only changed fields are sent, full snapshots on connect and heartbeat
+                Object.assign(robotStatus, jsonData);
+                renderStatus();
+            } else if (jsonData.type === 'metrics') {
+                // Receive-to-apply age of the last joystick frame on the robot
+                document.getElementById('joystickAge').textContent =
+                    `command age ${(jsonData.joyAgeUs / 1000).toFixed(1)} ms (max ${(jsonData.joyMaxAgeUs / 1000).toFixed(1)} ms)`;
+            } else if (jsonData.type === 'step-result') {
+                addStepResult(jsonData);
+            } else if (jsonData.type === 'step-trace') {
+                addStepTrace(jsonData);
+            } else if (jsonData.type === 'profiles') {
+                renderProfiles(jsonData);
+            } else if (jsonData.type === 'profile-diff') {
+                renderProfileDiff(jsonData);
+            } else if (jsonData.type === 'profile-error') {
+                alert('Tuning profile: ' + jsonData.message);
             } else if (jsonData.type === 'target-angle') {
                 console.log('Received target angle:', jsonData.value);
                 currentTargetAngle = jsonData.value;
@@ -62,6 +93,8 @@ function initWebSocket() {
 
     ws.onclose = function(event) {
         console.log('WebSocket disconnected');
+        robotStatus = {};
+        document.getElementById('statusDisplay').innerHTML = "<strong>WiFi Status:</strong> Robot not reachable, reconnecting...";
         if (consoleElement) {
             consoleElement.textContent += '\nWebSocket disconnected. Reconnecting...\n';
         }
@@ -87,11 +120,11 @@ function updatePIDDisplays() {
 
 // Adjust PID values with buttons
 function adjustPID(param, delta) {
-    ws.send(JSON.stringify({type: "adjust-pid", param: param, delta: delta}));
+    sendStamped({type: "adjust-pid", param: param, delta: delta});
 }
 
 function adjustTargetAngle(delta) {
-    ws.send(JSON.stringify({type: "adjust-target-angle", delta: delta}));
+    sendStamped({type: "adjust-target-angle", delta: delta});
 }
 
 // Setup event listeners
@@ -101,17 +134,181 @@ function setupEventListeners() {
     document.getElementById('calibrate').addEventListener('click', calibrateSensors);
     document.getElementById('resetPID').addEventListener('click', resetPID);
 
-    // Robot control buttons
-    document.getElementById('forward').addEventListener('click', () => sendCommand('forward'));
-    document.getElementById('backward').addEventListener('click', () => sendCommand('backward'));
-    document.getElementById('left').addEventListener('click', () => sendCommand('left'));
-    document.getElementById('right').addEventListener('click', () => sendCommand('right'));
-    document.getElementById('stop').addEventListener('click', () => sendCommand('stop'));
+    // Robot control buttons drive through the joystick stream while held
+    holdToDrive('forward', 60, 0);
+    holdToDrive('backward', -60, 0);
+    holdToDrive('left', 0, 60);
+    holdToDrive('right', 0, -60);
+    document.getElementById('stop').addEventListener('click', () => setJoystick(0, 0, false));
+}
+
+// Clock offset to the robot's micros(), estimated NTP style from ping/pong.
+// The sample with the lowest round trip of the last few gives the best estimate.
+const PING_INTERVAL_MS = 2000;
+const PING_SAMPLES = 8;
+const LATENCY_SAMPLES = 200;
+let clockSamples = [];
+let clockOffsetUs = null;
+let rttSamples = [];
+let telemetryAges = [];
+let robotLatency = null;
+
+function sendPing() {
+    if (ws && ws.readyState === WebSocket.OPEN) {
+        ws.send(JSON.stringify({type: "ping", t0: performance.now()}));
+    }
+}
+setInterval(sendPing, PING_INTERVAL_MS);
+
+// Robot micros() wraps at 2^32
+function wrapUs(us) {
+    return ((Math.round(us) % 4294967296) + 4294967296) % 4294967296;
+}
+
+function handlePong(pong) {
+    const t3 = performance.now();
+    const robotUs = pong.t1 + wrapUs(pong.t2 - pong.t1) / 2;
+    const rttMs = (t3 - pong.t0) - wrapUs(pong.t2 - pong.t1) / 1000;
+    clockSamples.push({ rtt: rttMs, offset: wrapUs(robotUs - (pong.t0 + t3) / 2 * 1000) });
+    if (clockSamples.length > PING_SAMPLES) clockSamples.shift();
+    const best = clockSamples.reduce((a, b) => (b.rtt < a.rtt ? b : a));
+    clockOffsetUs = best.offset;
+    pushSample(rttSamples, rttMs);
+    document.getElementById('clockOffset').textContent =
+        `clock offset from ${clockSamples.length} pings, best round trip ${best.rtt.toFixed(1)} ms`;
+}
+
+// Now in robot micros(), or 0 (unknown) before the first pong
+function robotNowUs() {
+    return clockOffsetUs === null ? 0 : wrapUs(performance.now() * 1000 + clockOffsetUs) || 1;
+}
+
+// JSON command carrying its origin time for the robot's latency figures
+function sendStamped(message) {
+    message.origin = robotNowUs();
+    ws.send(JSON.stringify(message));
+}
+
+function recordTelemetryAge(sampleUs) {
+    if (clockOffsetUs === null || sampleUs === undefined) return;
+    const age = wrapUs(robotNowUs() - sampleUs);
+    if (age < 2147483648) pushSample(telemetryAges, age / 1000);
+}
+
+function pushSample(samples, value) {
+    samples.push(value);
+    if (samples.length > LATENCY_SAMPLES) samples.shift();
+}
+
+function percentiles(samples) {
+    if (samples.length === 0) return null;
+    const sorted = samples.slice().sort((a, b) => a - b);
+    return [50, 90, 99].map(p => sorted[Math.floor(sorted.length * p / 100)]);
+}
+
+function renderLatency() {
+    const rows = [
+        ['Round trip', percentiles(rttSamples)],
+        ['Telemetry age when drawn', percentiles(telemetryAges)]
+    ];
+    const stages = [['total', 'origin to PWM'], ['network', 'network'], ['queue', 'receive to apply'], ['actuation', 'apply to PWM']];
+    if (robotLatency && robotLatency.drive) {
+        stages.forEach(([key, label]) => {
+            if (robotLatency.drive[key]) rows.push([`Joystick: ${label}`, robotLatency.drive[key]]);
+        });
+    }
+    if (robotLatency && robotLatency.command && robotLatency.command.total) {
+        rows.push(['Command: origin to apply', robotLatency.command.total]);
+    }
+    document.getElementById('latencyTable').innerHTML = rows.map(([label, p]) =>
+        `<tr><td>${label}</td>` + (p ? p.map(v => `<td>${v.toFixed(1)}</td>`).join('') : '<td>-</td><td>-</td><td>-</td>') + '</tr>'
+    ).join('');
+}
+
+// Joystick stream: 10-byte binary frames {magic 'J', version, seq (u16), throttle (i8), yaw (i8), origin (u32)}
+// at 40 Hz while driving. The robot keeps only the newest frame and stops if they stop arriving.
+const JOYSTICK_RATE_HZ = 40;
+const JOYSTICK_RELEASE_FRAMES = 3; // Zero frames sent after release, in case one is lost
+let joystick = { throttle: 0, yaw: 0, held: false, seq: 0, releaseFrames: 0, timer: null };
+
+function sendJoystickFrame() {
+    if (!ws || ws.readyState !== WebSocket.OPEN) return;
+    // Skip a frame rather than queue behind a slow link, only the newest value matters
+    if (ws.bufferedAmount > 64) return;
+    const frame = new DataView(new ArrayBuffer(10));
+    frame.setUint8(0, 0x4A);
+    frame.setUint8(1, 2);
+    frame.setUint16(2, joystick.seq, true);
+    frame.setInt8(4, joystick.throttle);
+    frame.setInt8(5, joystick.yaw);
+    frame.setUint32(6, robotNowUs(), true);
+    joystick.seq = (joystick.seq + 1) & 0xFFFF;
+    ws.send(frame.buffer);
+}
+
+function joystickTick() {
+    sendJoystickFrame();
+    if (!joystick.held && joystick.throttle === 0 && joystick.yaw === 0 && --joystick.releaseFrames <= 0) {
+        clearInterval(joystick.timer);
+        joystick.timer = null;
+    }
+}
+
+function setJoystick(throttle, yaw, held) {
+    joystick.throttle = Math.round(Math.max(-100, Math.min(100, throttle)));
+    joystick.yaw = Math.round(Math.max(-100, Math.min(100, yaw)));
+    joystick.held = held;
+    joystick.releaseFrames = JOYSTICK_RELEASE_FRAMES;
+    document.getElementById('joystickInfo').textContent = `throttle ${joystick.throttle}, yaw ${joystick.yaw}`;
+    drawJoystick();
+    if (!joystick.timer) {
+        sendJoystickFrame();
+        joystick.timer = setInterval(joystickTick, 1000 / JOYSTICK_RATE_HZ);
+    }
+}
+
+function holdToDrive(id, throttle, yaw) {
+    const button = document.getElementById(id);
+    button.addEventListener('pointerdown', () => setJoystick(throttle, yaw, true));
+    button.addEventListener('pointerup', () => setJoystick(0, 0, false));
+    button.addEventListener('pointerleave', () => { if (joystick.held) setJoystick(0, 0, false); });
+}
+
+function initJoystick() {
+    const pad = document.getElementById('joystickPad');
+    const position = event => {
+        const rect = pad.getBoundingClientRect();
+        const radius = rect.width / 2;
+        const x = (event.clientX - rect.left - radius) / radius;
+        const y = (event.clientY - rect.top - radius) / radius;
+        // Up drives forward, left turns left
+        setJoystick(-y * 100, -x * 100, true);
+    };
+    pad.addEventListener('pointerdown', event => { pad.setPointerCapture(event.pointerId); position(event); });
+    pad.addEventListener('pointermove', event => { if (joystick.held) position(event); });
+    pad.addEventListener('pointerup', () => setJoystick(0, 0, false));
+    pad.addEventListener('pointercancel', () => setJoystick(0, 0, false));
+    drawJoystick();
+}
+
+function drawJoystick() {
+    const pad = document.getElementById('joystickPad');
+    const ctx = pad.getContext('2d');
+    const radius = pad.width / 2;
+    ctx.clearRect(0, 0, pad.width, pad.height);
+    ctx.strokeStyle = '#ccc';
+    ctx.beginPath();
+    ctx.arc(radius, radius, radius - 2, 0, 2 * Math.PI);
+    ctx.stroke();
+    ctx.fillStyle = joystick.held ? '#198754' : '#6c757d';
+    ctx.beginPath();
+    ctx.arc(radius - joystick.yaw / 100 * radius, radius - joystick.throttle / 100 * radius, 15, 0, 2 * Math.PI);
+    ctx.fill();
 }
 
 // Update PID values on the robot
 function updatePID() {
-    ws.send(JSON.stringify({type: "set-pid", kp: currentPID.kp, ki: currentPID.ki, kd: currentPID.kd}));
+    sendStamped({type: "set-pid", kp: currentPID.kp, ki: currentPID.ki, kd: currentPID.kd});
 }
 
 // Calibrate sensors
@@ -126,7 +323,7 @@ function calibrateSensors() {
         .then(response => response.json())
         .then(data => {
             if (data.success) {
-                alert('Calibration completed successfully!');
+                alert('Calibration started. Keep the robot still for a few seconds.');
             } else {
                 alert('Calibration failed: ' + data.message);
             }
@@ -151,34 +348,133 @@ function resetPID() {
     updatePID();
 }
 
-// Send robot control commands
-function sendCommand(command) {
-    fetch('/control', {
-        method: 'POST',
-        headers: {
-            'Content-Type': 'application/x-www-form-urlencoded',
-        },
-        body: `command=${command}&value=`
-    })
-    .catch(error => console.error('Error sending command:', error));
+// Clear the latch left by an IMU fault; the robot arms once the estimator settles
+function sendArm() {
+    if (ws && ws.readyState === WebSocket.OPEN) {
+        sendStamped({type: "arm"});
+    }
 }
 
-// Update status display
-function updateStatus() {
-    fetch('/status')
-        .then(response => response.json())
-        .then(data => {
-            let statusHtml = "<strong>WiFi Status:</strong> ";
-            if (data.mode === "AP") {
-                statusHtml += `Access Point Mode - IP: ${data.ip}`;
-            } else if (data.connected) {
-                statusHtml += `Connected to ${data.ssid} - IP: ${data.ip}`;
-            } else {
-                statusHtml += "Not Connected";
-            }
-            document.getElementById('statusDisplay').innerHTML = statusHtml;
-        })
-        .catch(error => console.error('Error updating status:', error));
+// Arm, trigger or stop the control-tick capture buffer
+function sendCapture(action) {
+    if (ws && ws.readyState === WebSocket.OPEN) {
+        sendStamped({type: "capture", action: action});
+    }
+}
+
+// Step-response test, results are pushed to every dashboard
+function runStepTest() {
+    if (ws && ws.readyState === WebSocket.OPEN) {
+        sendStamped({
+            type: "step-test",
+            kind: document.getElementById('stepKind').value,
+            amplitude: parseFloat(document.getElementById('stepAmplitude').value),
+            duration: parseFloat(document.getElementById('stepDuration').value)
+        });
+    }
+}
+
+function abortStepTest() {
+    if (ws && ws.readyState === WebSocket.OPEN) {
+        sendStamped({type: "step-test", kind: "abort", amplitude: 0, duration: 1});
+    }
+}
+
+function formatMetric(value, digits) {
+    return value === null || value === undefined ? '-' : value.toFixed(digits);
+}
+
+function addStepResult(result) {
+    const row = document.createElement('tr');
+    if (result.error) {
+        // No run number: the start was rejected
+        row.innerHTML = result.run === undefined ?
+            `<td>-</td><td colspan="7">rejected: ${result.error}</td>` :
+            `<td>${result.run}</td><td colspan="7">aborted: ${result.error}</td>`;
+    } else {
+        const overshoot = result.kind === 'step' ? `${formatMetric(result.overshoot, 1)} %` : `${formatMetric(result.peak, 2)}&deg; peak`;
+        row.innerHTML = `<td style="color:${stepRunColor(result.run)}">${result.run}</td>` +
+            `<td>${result.kind} ${result.amplitude}</td>` +
+            `<td>${result.profile || ''} ${result.kp}/${result.ki}/${result.kd}</td>` +
+            `<td>${formatMetric(result.riseTime, 3)}</td><td>${overshoot}</td>` +
+            `<td>${formatMetric(result.settlingTime, 3)}</td>` +
+            `<td>${formatMetric(result.steadyStateError, 3)}</td><td>${formatMetric(result.iae, 3)}</td>`;
+        startStepRun(result.run);
+    }
+    document.getElementById('stepResults').prepend(row);
+}
+
+// Tuning profiles stored on the robot
+function sendProfile(message) {
+    if (ws && ws.readyState === WebSocket.OPEN) {
+        ws.send(JSON.stringify(message));
+    }
+}
+
+function loadProfile() {
+    const name = document.getElementById('profileSelect').value;
+    if (name) sendProfile({type: "profile-load", name: name});
+}
+
+function saveProfile() {
+    const name = document.getElementById('profileName').value.trim();
+    if (name) sendProfile({type: "profile-save", name: name});
+}
+
+function diffProfile() {
+    const name = document.getElementById('profileSelect').value;
+    if (name) sendProfile({type: "profile-diff", name: name});
+}
+
+function renderProfiles(list) {
+    const select = document.getElementById('profileSelect');
+    select.innerHTML = '';
+    list.names.forEach(name => {
+        const option = document.createElement('option');
+        option.value = name;
+        option.textContent = name;
+        option.selected = name === list.active;
+        select.appendChild(option);
+    });
+    const active = list.active || '(unnamed)';
+    document.getElementById('profileActive').textContent =
+        `Active: ${active}${list.modified ? ' (modified)' : ''}`;
+
+    currentPID.kp = list.tuning.kp;
+    currentPID.ki = list.tuning.ki;
+    currentPID.kd = list.tuning.kd;
+    updatePIDDisplays();
+    currentTargetAngle = list.tuning['target-angle'];
+    document.getElementById('targetAngleValue').textContent = currentTargetAngle.toFixed(2);
+}
+
+function renderProfileDiff(diff) {
+    const lines = diff.changes.map(c => `${c.field}: ${c.from} -> ${c.to}`);
+    document.getElementById('profileDiff').textContent =
+        `${diff.from} vs ${diff.to}\n` + (lines.length ? lines.join('\n') : 'identical');
+}
+
+// Update status display from the status pushed over the WebSocket
+function renderStatus() {
+    let statusHtml = "<strong>WiFi Status:</strong> ";
+    if (robotStatus.mode === "AP") {
+        statusHtml += `Access Point Mode - IP: ${robotStatus.ip}`;
+    } else if (robotStatus.connected) {
+        statusHtml += `Connected to ${robotStatus.ssid} - IP: ${robotStatus.ip} (${robotStatus.rssi} dBm)`;
+    } else {
+        statusHtml += "Not Connected";
+    }
+    if (robotStatus.controller) {
+        statusHtml += ` | <strong>Controller:</strong> ${robotStatus.controller}`;
+    }
+    if (robotStatus.shed && robotStatus.shed !== 'none') {
+        statusHtml += ` | <strong>Shedding:</strong> ${robotStatus.shed}`;
+    }
+    document.getElementById('statusDisplay').innerHTML = statusHtml;
+    if (robotStatus.capture) {
+        document.getElementById('captureState').textContent =
+            `${robotStatus.capture} (${robotStatus.captureSamples} samples)`;
+    }
 }
 
 // Clear console
@@ -0,0 +1,69 @@
+# Pre-build script: minify and gzip the dashboard in data/ into a staging
+# directory that becomes the LittleFS image, plus an etags.txt manifest
+# the firmware uses for If-None-Match / 304 handling.
+#
+# Runs automatically for `pio run -t buildfs` / `uploadfs`; can also be run
+# by hand: python scripts/build_web_assets.py data build/webdata
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+MINIFY_EXTENSIONS = (".html", ".js", ".css")
+
+
+def minify(name, text):
+    # Conservative: only whitespace, blank lines and whole-line comments, so
+    # string literals such as 'ws://' are never touched
+    if name.endswith(".html"):
+        text = re.sub(r"<!--.*?-->", "", text, flags=re.S)
+    if name.endswith(".css"):
+        text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    lines = []
+    for line in text.splitlines():
+        line = line.strip()
+        if not line:
+            continue
+        if name.endswith(".js") and line.startswith("//"):
+            continue
+        lines.append(line)
+    return "\n".join(lines) + "\n"
+
+
+def build_assets(src_dir, dst_dir):
+    os.makedirs(dst_dir, exist_ok=True)
+    for stale in os.listdir(dst_dir):
+        os.remove(os.path.join(dst_dir, stale))
+
+    etags = []
+    for name in sorted(os.listdir(src_dir)):
+        path = os.path.join(src_dir, name)
+        if not os.path.isfile(path):
+            continue
+        with open(path, "rb") as f:
+            data = f.read()
+        if name.endswith(MINIFY_EXTENSIONS):
+            data = minify(name, data.decode("utf-8")).encode("utf-8")
+
+        # mtime=0 keeps the output (and its ETag) identical across rebuilds
+        packed = gzip.compress(data, compresslevel=9, mtime=0)
+        with open(os.path.join(dst_dir, name + ".gz"), "wb") as f:
+            f.write(packed)
+
+        etag = hashlib.sha1(packed).hexdigest()[:16]
+        etags.append("/%s %s\n" % (name, etag))
+        print("web asset %-14s %6d -> %6d bytes" % (name, os.path.getsize(path), len(packed)))
+
+    with open(os.path.join(dst_dir, "etags.txt"), "w") as f:
+        f.writelines(etags)
+
+
+try:
+    Import("env")  # noqa: F821 (provided by PlatformIO/SCons)
+    staging = os.path.join(env.subst("$BUILD_DIR"), "webdata")  # noqa: F821
+    build_assets(env.subst("$PROJECT_DATA_DIR"), staging)  # noqa: F821
+    env.Replace(PROJECT_DATA_DIR=staging)  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        build_assets(sys.argv[1], sys.argv[2])
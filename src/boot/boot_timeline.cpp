@@ -0,0 +1,47 @@
+#include "boot_timeline.h"
+#include "wifi/wifi_manager.h"
+
+// Report whatever was reached if the robot is not armed and reachable by then
+const uint32_t BOOT_REPORT_TIMEOUT_US = 30000000;
+
+static const char *BOOT_PHASE_NAMES[BOOT_PHASE_COUNT] = {
+    "setup", "controller", "imu", "calibrated", "fs-mounted",
+    "server-started", "network-up", "scheduler", "armed"};
+
+// Microseconds since reset, 0 while the phase is pending
+static volatile uint32_t bootPhaseTimes[BOOT_PHASE_COUNT];
+static bool bootReported = false;
+
+void markBootPhase(BootPhase phase)
+{
+    if (bootPhaseTimes[phase] == 0)
+        bootPhaseTimes[phase] = micros() | 1; // Never store 0 for a reached phase
+}
+
+uint32_t bootPhaseUs(BootPhase phase)
+{
+    return bootPhaseTimes[phase];
+}
+
+void reportBootTimeline()
+{
+    if (bootReported)
+        return;
+    bool complete = bootPhaseTimes[BOOT_ARMED] && bootPhaseTimes[BOOT_NETWORK_UP];
+    if (!complete && micros() < BOOT_REPORT_TIMEOUT_US)
+        return;
+    bootReported = true;
+
+    SERIAL_PRINTLN(complete ? "Boot timeline (ms since reset):" : "Boot timeline, incomplete (ms since reset):");
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++)
+    {
+        if (bootPhaseTimes[i])
+        {
+            SERIAL_PRINTLN("  " + String(BOOT_PHASE_NAMES[i]) + ": " + String(bootPhaseTimes[i] / 1000.0, 1));
+        }
+        else
+        {
+            SERIAL_PRINTLN("  " + String(BOOT_PHASE_NAMES[i]) + ": pending");
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include <Arduino.h>
+
+// Boot milestones, recorded once each from whichever task reaches them
+enum BootPhase
+{
+    BOOT_SETUP,          // setup() entered
+    BOOT_CONTROLLER,     // Motor/LED outputs configured
+    BOOT_IMU,            // IMU woken up
+    BOOT_CALIBRATED,     // Gyro offsets measured
+    BOOT_FS_MOUNTED,     // LittleFS mounted (network task)
+    BOOT_SERVER_STARTED, // Web server listening (network task)
+    BOOT_NETWORK_UP,     // Station got an IP or fallback AP started
+    BOOT_SCHEDULER,      // Control loops scheduled
+    BOOT_ARMED,          // Estimator converged, balancing enabled
+    BOOT_PHASE_COUNT
+};
+
+void markBootPhase(BootPhase phase);
+uint32_t bootPhaseUs(BootPhase phase); // 0 if not reached yet
+
+// Print the timeline once, when armed and reachable (or after a timeout)
+void reportBootTimeline();
+
+#endif
@@ -0,0 +1,187 @@
+#include "command_queue.h"
+#include "control/input_controller.h"
+#include "self_balancing/balance.h"
+#include "wifi/wifi_manager.h"
+#include "gyro/gyro.h"
+#include "telemetry/capture.h"
+#include "control/tuning.h"
+#include "self_balancing/step_test.h"
+#include "telemetry/latency.h"
+
+const int COMMAND_QUEUE_LENGTH = 16;
+
+static QueueHandle_t commandQueue = NULL;
+CommandStats commandStats = {0, 0, 0, 0, 0};
+
+// posted/dropped are counted from the loop task (serial) and the AsyncTCP task (HTTP/WS)
+static portMUX_TYPE commandStatsMux = portMUX_INITIALIZER_UNLOCKED;
+
+void initCommandQueue()
+{
+    commandQueue = xQueueCreate(COMMAND_QUEUE_LENGTH, sizeof(ControlCommand));
+}
+
+// Post a command from any task; never blocks, drops the command if the queue is full
+bool postCommand(CommandType type, CommandSource source, float a, float b, float c)
+{
+    ControlCommand cmd;
+    cmd.type = type;
+    cmd.source = source;
+    cmd.args[0] = a;
+    cmd.args[1] = b;
+    cmd.args[2] = c;
+    cmd.originUs = 0;
+    return postCommand(cmd);
+}
+
+// Post a command already filled in by a transport parser
+bool postCommand(ControlCommand &cmd)
+{
+    if (commandQueue == NULL)
+        return false;
+
+    cmd.enqueuedAt = micros();
+    bool sent = xQueueSend(commandQueue, &cmd, 0) == pdTRUE;
+    portENTER_CRITICAL(&commandStatsMux);
+    if (sent)
+        commandStats.posted++;
+    else
+        commandStats.dropped++;
+    portEXIT_CRITICAL(&commandStatsMux);
+    return sent;
+}
+
+int pendingCommands()
+{
+    return commandQueue ? uxQueueMessagesWaiting(commandQueue) : 0;
+}
+
+// Gain changes are staged and swapped in by the control loop once the queue is drained
+static TuningProfile adjustPID(PidParam param, float delta)
+{
+    // PidParam follows the first TuningFieldId entries
+    TuningEdit edit = {param, param == PID_BASE_SPEED ? (int)delta : delta, true};
+    TuningProfile tuning;
+    editTuning(&edit, 1, &tuning);
+    return tuning;
+}
+
+static void applyCommand(const ControlCommand &cmd)
+{
+    switch (cmd.type)
+    {
+    case CMD_SET_SPEED:
+        setSpeed((int)cmd.args[0]);
+        break;
+    case CMD_ADJUST_SPEED:
+        adjustSpeed((int)cmd.args[0]);
+        break;
+    case CMD_FORWARD:
+        moveForward();
+        break;
+    case CMD_BACKWARD:
+        moveBackward();
+        break;
+    case CMD_LEFT:
+        turnLeft();
+        break;
+    case CMD_RIGHT:
+        turnRight();
+        break;
+    case CMD_STOP:
+        stopDriving();
+        break;
+    case CMD_SET_PID:
+    {
+        // Ranges already checked against the command schema
+        TuningEdit edits[] = {{TUNING_KP, cmd.args[0], false}, {TUNING_KI, cmd.args[1], false}, {TUNING_KD, cmd.args[2], false}};
+        TuningProfile tuning;
+        editTuning(edits, 3, &tuning);
+        SERIAL_PRINTLN("PID values updated: Kp=" + String(tuning.kp, 3) + ", Ki=" + String(tuning.ki, 3) + ", Kd=" + String(tuning.kd, 3));
+        sendPIDValues();
+        break;
+    }
+    case CMD_ADJUST_PID:
+    {
+        TuningProfile tuning = adjustPID((PidParam)(int)cmd.args[0], cmd.args[1]);
+        SERIAL_PRINTLN("Adjusted PID gains: Kp=" + String(tuning.kp, 3) + ", Ki=" + String(tuning.ki, 3) + ", Kd=" + String(tuning.kd, 3) + ", BaseSpeed=" + String((int)tuning.baseSpeed));
+        sendPIDValues();
+        break;
+    }
+    case CMD_ADJUST_TARGET:
+        handleTargetAngle(cmd.args[0], 0);
+        sendTargetAngle();
+        break;
+    case CMD_ADJUST_DEADBAND:
+        handleTargetAngle(0, cmd.args[0]);
+        break;
+    case CMD_CALIBRATE:
+        // Sampled over the next control ticks; re-armed once the estimator settles on the new offsets
+        disarmBalance();
+        clearFaultLatch();
+        startGyroCalibration();
+        SERIAL_PRINTLN("Calibrating, keep the robot still.");
+        break;
+    case CMD_TOGGLE_STOP_MODE:
+        motorConfig.stopMode = (motorConfig.stopMode == MOTOR_COAST) ? MOTOR_BRAKE : MOTOR_COAST;
+        Serial.println(String("Motor stop mode: ") + (motorConfig.stopMode == MOTOR_BRAKE ? "brake" : "coast"));
+        break;
+    case CMD_GET_PID:
+        sendPIDValues();
+        break;
+    case CMD_GET_TARGET_ANGLE:
+        sendTargetAngle();
+        break;
+    case CMD_GET_CONSOLE:
+        sendConsoleBuffer();
+        break;
+    case CMD_TOGGLE_LED:
+        toggleLed();
+        break;
+    case CMD_CAPTURE:
+        captureControlAction((CaptureAction)(int)cmd.args[0]);
+        break;
+    case CMD_STEP_TEST:
+        startStepTest((StepTestKind)(int)cmd.args[0], cmd.args[1], cmd.args[2]);
+        break;
+    case CMD_ARM:
+        if (imuHealth.faulted)
+        {
+            SERIAL_PRINTLN("IMU still faulted, not re-arming");
+        }
+        else
+        {
+            clearFaultLatch();
+            SERIAL_PRINTLN("Fault cleared, arming once the estimator settles");
+        }
+        break;
+    case CMD_SUBSCRIBE:
+    case CMD_COUNT:
+        break;
+    }
+}
+
+// Drain the queue so every command lands between two control ticks
+void applyPendingCommands()
+{
+    if (commandQueue == NULL)
+        return;
+
+    ControlCommand cmd;
+    while (xQueueReceive(commandQueue, &cmd, 0) == pdTRUE)
+    {
+        uint32_t latency = micros() - cmd.enqueuedAt;
+        commandStats.lastLatencyUs = latency;
+        if (latency > commandStats.maxLatencyUs)
+            commandStats.maxLatencyUs = latency;
+        commandStats.applied++;
+
+        applyCommand(cmd);
+
+        if (cmd.originUs != 0)
+        {
+            LatencyTrace trace = {cmd.originUs, cmd.enqueuedAt, micros(), 0};
+            recordLatency(LATENCY_COMMAND, trace);
+        }
+    }
+}
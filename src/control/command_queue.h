@@ -0,0 +1,72 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <Arduino.h>
+
+// Commands posted by serial, HTTP and WebSocket handlers and applied by the control loop
+enum CommandType {
+    CMD_SET_SPEED,          // args[0] = speed (0-100)
+    CMD_ADJUST_SPEED,       // args[0] = delta
+    CMD_FORWARD,
+    CMD_BACKWARD,
+    CMD_LEFT,
+    CMD_RIGHT,
+    CMD_STOP,
+    CMD_SET_PID,            // args = kp, ki, kd
+    CMD_ADJUST_PID,         // args = PidParam, delta
+    CMD_ADJUST_TARGET,      // args[0] = delta (degrees)
+    CMD_ADJUST_DEADBAND,    // args[0] = delta (degrees)
+    CMD_CALIBRATE,
+    CMD_TOGGLE_STOP_MODE,
+    CMD_GET_PID,
+    CMD_GET_TARGET_ANGLE,
+    CMD_GET_CONSOLE,
+    CMD_TOGGLE_LED,
+    CMD_SUBSCRIBE,          // args = StreamId, rate (Hz, 0 unsubscribes); handled by the WebSocket transport
+    CMD_CAPTURE,            // args[0] = CaptureAction
+    CMD_STEP_TEST,          // args = StepTestKind, amplitude, duration (s)
+    CMD_ARM,                // Clear the IMU fault latch so balancing can re-arm
+    CMD_COUNT
+};
+
+enum PidParam {
+    PID_KP,
+    PID_KI,
+    PID_KD,
+    PID_BASE_SPEED
+};
+
+enum CommandSource {
+    SRC_SERIAL,
+    SRC_HTTP,
+    SRC_WS
+};
+
+const int MAX_COMMAND_ARGS = 3;
+
+struct ControlCommand {
+    CommandType type;
+    CommandSource source;
+    float args[MAX_COMMAND_ARGS];
+    uint32_t enqueuedAt; // micros() when posted
+    uint32_t originUs;   // Sender's time of the action in robot micros(), 0 if unknown
+};
+
+// Enqueue-to-apply latency and queue health
+struct CommandStats {
+    uint32_t posted;
+    uint32_t applied;
+    uint32_t dropped;       // Queue full at post time
+    uint32_t lastLatencyUs;
+    uint32_t maxLatencyUs;
+};
+
+extern CommandStats commandStats;
+
+void initCommandQueue();
+bool postCommand(CommandType type, CommandSource source, float a = 0, float b = 0, float c = 0);
+bool postCommand(ControlCommand &cmd);
+void applyPendingCommands(); // Called by the control loop at the start of a tick
+int pendingCommands();
+
+#endif
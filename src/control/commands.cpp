@@ -0,0 +1,223 @@
+#include "commands.h"
+#include "wifi/ws_streams.h"
+#include "telemetry/capture.h"
+#include "self_balancing/step_test.h"
+
+static const char *const PID_PARAM_NAMES[] = {"kp", "ki", "kd", "base-speed", NULL};
+
+// Indexed by CommandType
+static const CommandSpec COMMAND_SPECS[] = {
+    {CMD_SET_SPEED, "speed", 1, {{"value", 0, 100, NULL}}},
+    {CMD_ADJUST_SPEED, "adjust-speed", 1, {{"delta", -100, 100, NULL}}},
+    {CMD_FORWARD, "forward", 0, {}},
+    {CMD_BACKWARD, "backward", 0, {}},
+    {CMD_LEFT, "left", 0, {}},
+    {CMD_RIGHT, "right", 0, {}},
+    {CMD_STOP, "stop", 0, {}},
+    {CMD_SET_PID, "set-pid", 3, {{"kp", 0, 500, NULL}, {"ki", 0, 100, NULL}, {"kd", 0, 100, NULL}}},
+    {CMD_ADJUST_PID, "adjust-pid", 2, {{"param", PID_KP, PID_BASE_SPEED, PID_PARAM_NAMES}, {"delta", -100, 100, NULL}}},
+    {CMD_ADJUST_TARGET, "adjust-target-angle", 1, {{"delta", -10, 10, NULL}}},
+    {CMD_ADJUST_DEADBAND, "adjust-deadband", 1, {{"delta", -10, 10, NULL}}},
+    {CMD_CALIBRATE, "calibrate", 0, {}},
+    {CMD_TOGGLE_STOP_MODE, "toggle-stop-mode", 0, {}},
+    {CMD_GET_PID, "get-pid", 0, {}},
+    {CMD_GET_TARGET_ANGLE, "get-target-angle", 0, {}},
+    {CMD_GET_CONSOLE, "get-buffer", 0, {}},
+    {CMD_TOGGLE_LED, "toggle", 0, {}},
+    {CMD_SUBSCRIBE, "subscribe", 2, {{"stream", STREAM_TILT, STREAM_COUNT - 1, STREAM_NAMES}, {"rate", 0, 100, NULL}}},
+    {CMD_CAPTURE, "capture", 1, {{"action", CAPTURE_ARM, CAPTURE_STOP, CAPTURE_ACTION_NAMES}}},
+    {CMD_STEP_TEST, "step-test", 3, {{"kind", STEP_TARGET, STEP_ABORT, STEP_TEST_KIND_NAMES}, {"amplitude", -30, 30, NULL}, {"duration", 0.5, 5, NULL}}},
+    {CMD_ARM, "arm", 0, {}},
+};
+
+static_assert(sizeof(COMMAND_SPECS) / sizeof(COMMAND_SPECS[0]) == CMD_COUNT, "COMMAND_SPECS must cover every CommandType");
+
+// Serial console key bindings
+struct SerialBinding {
+    char key;
+    CommandType type;
+    float arg0;
+    float arg1;
+};
+
+static const SerialBinding SERIAL_BINDINGS[] = {
+    {'c', CMD_CALIBRATE, 0, 0},
+    {'z', CMD_ARM, 0, 0},
+    {'v', CMD_ADJUST_TARGET, 0.1, 0},    // Increase target angle by 0.1 degree
+    {'b', CMD_ADJUST_TARGET, -0.1, 0},   // Decrease target angle by 0.1 degree
+    {'t', CMD_ADJUST_DEADBAND, 1, 0},    // Increase deadband by 1 degree
+    {'g', CMD_ADJUST_DEADBAND, -1, 0},   // Decrease deadband by 1 degree
+    {'f', CMD_FORWARD, 0, 0},
+    {'l', CMD_LEFT, 0, 0},
+    {'r', CMD_RIGHT, 0, 0},
+    {'s', CMD_STOP, 0, 0},
+    {'m', CMD_TOGGLE_STOP_MODE, 0, 0},
+    {'+', CMD_ADJUST_SPEED, 10, 0},
+    {'-', CMD_ADJUST_SPEED, -10, 0},
+    {'w', CMD_ADJUST_PID, PID_KP, 0.1},
+    {'x', CMD_ADJUST_PID, PID_KP, -0.1},
+    {'e', CMD_ADJUST_PID, PID_KI, 0.001},
+    {'d', CMD_ADJUST_PID, PID_KI, -0.001},
+    {'y', CMD_ADJUST_PID, PID_KD, 0.001},
+    {'h', CMD_ADJUST_PID, PID_KD, -0.001},
+    {'q', CMD_ADJUST_PID, PID_BASE_SPEED, 5},
+    {'a', CMD_ADJUST_PID, PID_BASE_SPEED, -5},
+};
+
+// Lookup tables built once at boot: open-addressed name hash and direct key map
+const int NAME_SLOTS = 64; // Power of two, well above CMD_COUNT
+static int8_t nameSlots[NAME_SLOTS];
+static int8_t serialSlots[128];
+
+void initCommands()
+{
+    memset(nameSlots, -1, sizeof(nameSlots));
+    memset(serialSlots, -1, sizeof(serialSlots));
+
+    for (int i = 0; i < CMD_COUNT; i++)
+    {
+        if (COMMAND_SPECS[i].type != i)
+        {
+            Serial.printf("Command table out of order at %d (%s)\n", i, COMMAND_SPECS[i].name);
+        }
+        uint32_t slot = commandHash(COMMAND_SPECS[i].name) & (NAME_SLOTS - 1);
+        while (nameSlots[slot] >= 0)
+            slot = (slot + 1) & (NAME_SLOTS - 1);
+        nameSlots[slot] = i;
+    }
+
+    for (size_t i = 0; i < sizeof(SERIAL_BINDINGS) / sizeof(SERIAL_BINDINGS[0]); i++)
+    {
+        serialSlots[(uint8_t)SERIAL_BINDINGS[i].key & 0x7F] = i;
+    }
+}
+
+const CommandSpec &commandSpec(CommandType type)
+{
+    return COMMAND_SPECS[type];
+}
+
+const char *commandErrorString(CommandError error)
+{
+    switch (error)
+    {
+    case CMD_OK:
+        return "ok";
+    case CMD_ERR_UNKNOWN:
+        return "unknown command";
+    case CMD_ERR_MISSING_ARG:
+        return "missing argument";
+    case CMD_ERR_BAD_ARG:
+        return "invalid argument";
+    case CMD_ERR_OUT_OF_RANGE:
+        return "argument out of range";
+    case CMD_ERR_QUEUE_FULL:
+        return "command queue full";
+    }
+    return "error";
+}
+
+static void clearCommand(ControlCommand &cmd, CommandType type, CommandSource source)
+{
+    cmd.type = type;
+    cmd.source = source;
+    for (int i = 0; i < MAX_COMMAND_ARGS; i++)
+        cmd.args[i] = 0;
+    cmd.enqueuedAt = 0;
+    cmd.originUs = 0;
+}
+
+CommandError parseCommandName(const char *name, CommandSource source, ControlCommand &cmd)
+{
+    if (name == NULL)
+        return CMD_ERR_UNKNOWN;
+
+    uint32_t slot = commandHash(name) & (NAME_SLOTS - 1);
+    while (nameSlots[slot] >= 0)
+    {
+        const CommandSpec &spec = COMMAND_SPECS[nameSlots[slot]];
+        if (strcmp(spec.name, name) == 0)
+        {
+            clearCommand(cmd, spec.type, source);
+            return CMD_OK;
+        }
+        slot = (slot + 1) & (NAME_SLOTS - 1);
+    }
+    return CMD_ERR_UNKNOWN;
+}
+
+CommandError setCommandArg(ControlCommand &cmd, int index, float value)
+{
+    const CommandSpec &spec = COMMAND_SPECS[cmd.type];
+    if (index >= spec.argCount)
+        return CMD_ERR_BAD_ARG;
+    if (isnan(value) || isinf(value))
+        return CMD_ERR_BAD_ARG;
+
+    const CommandArg &arg = spec.args[index];
+    if (value < arg.minValue || value > arg.maxValue)
+        return CMD_ERR_OUT_OF_RANGE;
+
+    cmd.args[index] = value;
+    return CMD_OK;
+}
+
+// Parse a text argument, either one of the argument's choice names or a number
+CommandError setCommandArgText(ControlCommand &cmd, int index, const char *text)
+{
+    const CommandSpec &spec = COMMAND_SPECS[cmd.type];
+    if (index >= spec.argCount)
+        return CMD_ERR_BAD_ARG;
+    if (text == NULL || *text == 0)
+        return CMD_ERR_MISSING_ARG;
+
+    const CommandArg &arg = spec.args[index];
+    if (arg.choices != NULL)
+    {
+        for (int i = 0; arg.choices[i] != NULL; i++)
+        {
+            if (strcmp(arg.choices[i], text) == 0)
+                return setCommandArg(cmd, index, arg.minValue + i);
+        }
+        return CMD_ERR_BAD_ARG;
+    }
+
+    char *end;
+    float value = strtof(text, &end);
+    if (end == text || *end != 0)
+        return CMD_ERR_BAD_ARG;
+    return setCommandArg(cmd, index, value);
+}
+
+CommandError parseSerialKey(char key, ControlCommand &cmd)
+{
+    int8_t index = serialSlots[(uint8_t)key & 0x7F];
+    if (index < 0 || (uint8_t)key > 0x7F)
+        return CMD_ERR_UNKNOWN;
+
+    const SerialBinding &binding = SERIAL_BINDINGS[index];
+    clearCommand(cmd, binding.type, SRC_SERIAL);
+    cmd.args[0] = binding.arg0;
+    cmd.args[1] = binding.arg1;
+    return CMD_OK;
+}
+
+// "name" plus an optional single value, as sent by /control and plain-text WS messages
+CommandError parseTextCommand(const char *name, const char *value, CommandSource source, ControlCommand &cmd)
+{
+    CommandError error = parseCommandName(name, source, cmd);
+    if (error != CMD_OK)
+        return error;
+
+    const CommandSpec &spec = COMMAND_SPECS[cmd.type];
+    if (spec.argCount > 1)
+        return CMD_ERR_MISSING_ARG;
+    if (spec.argCount == 1)
+        return setCommandArgText(cmd, 0, value);
+    return CMD_OK;
+}
+
+CommandError submitCommand(ControlCommand &cmd)
+{
+    return postCommand(cmd) ? CMD_OK : CMD_ERR_QUEUE_FULL;
+}
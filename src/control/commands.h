@@ -0,0 +1,54 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <Arduino.h>
+#include "command_queue.h"
+
+// Single command schema shared by the serial, HTTP and WebSocket transports.
+// Each transport parses into a preallocated ControlCommand, validated against
+// the same argument ranges, and posts it to the command queue.
+
+struct CommandArg {
+    const char *name;            // HTTP/WS field name
+    float minValue;
+    float maxValue;
+    const char *const *choices;  // Optional names for enum arguments (NULL-terminated)
+};
+
+struct CommandSpec {
+    CommandType type;
+    const char *name;            // HTTP command / WS message type
+    uint8_t argCount;
+    CommandArg args[MAX_COMMAND_ARGS];
+};
+
+enum CommandError {
+    CMD_OK,
+    CMD_ERR_UNKNOWN,
+    CMD_ERR_MISSING_ARG,
+    CMD_ERR_BAD_ARG,
+    CMD_ERR_OUT_OF_RANGE,
+    CMD_ERR_QUEUE_FULL
+};
+
+// FNV-1a, usable at compile time
+constexpr uint32_t commandHash(const char *s, uint32_t h = 2166136261u)
+{
+    return *s ? commandHash(s + 1, (h ^ (uint8_t)*s) * 16777619u) : h;
+}
+
+void initCommands();
+const CommandSpec &commandSpec(CommandType type);
+const char *commandErrorString(CommandError error);
+
+// Transport parsers, all write into a caller-owned ControlCommand
+CommandError parseCommandName(const char *name, CommandSource source, ControlCommand &cmd);
+CommandError setCommandArg(ControlCommand &cmd, int index, float value);
+CommandError setCommandArgText(ControlCommand &cmd, int index, const char *text);
+CommandError parseSerialKey(char key, ControlCommand &cmd);
+CommandError parseTextCommand(const char *name, const char *value, CommandSource source, ControlCommand &cmd);
+
+// Post a parsed command, reporting a full queue as an error
+CommandError submitCommand(ControlCommand &cmd);
+
+#endif
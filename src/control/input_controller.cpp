@@ -1,4 +1,7 @@
 #include "input_controller.h"
+#include "command_queue.h"
+#include "commands.h"
+#include "tuning.h"
 
 // Onboard LED pin for testing (GPIO 2 on most ESP32 boards)
 #define LED_PIN 2
@@ -20,8 +23,27 @@ const int LEDC_RESOLUTION = 8; // 0-255
 
 // Current speed (0-100)
 static int currentSpeed = 0;
-float targetAngle = 87.0;
-float deadBand = 0.0; // degrees
+
+// Motor driver behaviour, applied once per setMotorSpeeds() call (one control tick)
+// Coasting stays the default; 'm' switches to a short brake on every stop
+MotorConfig motorConfig = {MOTOR_COAST, REVERSE_BRAKE, 20, 2};
+
+// Per-motor driver state
+struct MotorChannel
+{
+    uint8_t fwdPin;
+    uint8_t revPin;
+    uint8_t ledcChannel;
+    int duty;      // Last applied duty (-100 to 100)
+    int holdTicks; // Remaining ticks of brake/coast before a reversal
+    int stopTicks; // Remaining ticks of brake after stopping, MOTOR_BRAKE only
+};
+
+static MotorChannel leftMotor = {MOTOR_LEFT_FWD, MOTOR_LEFT_REV, LEDC_CHANNEL_LEFT, 0, 0, 0};
+static MotorChannel rightMotor = {MOTOR_RIGHT_FWD, MOTOR_RIGHT_REV, LEDC_CHANNEL_RIGHT, 0, 0, 0};
+
+// Drive setpoints consumed by balanceRobot()
+DriveCommand driveCommand = {0.0, 0.0};
 
 // Initialize the controller
 void initController()
@@ -48,127 +70,60 @@ void initController()
     Serial.println("Controller initialized - LED PWM ready for testing");
 }
 
+// Serial console keys are looked up in the shared command table and posted to the command queue
 void handleKeyboardInputs()
 {
+    ControlCommand cmd;
     while (Serial.available())
     {
         char key = Serial.read();
-        switch (key)
+        if (key == '\n' || key == '\r')
+            continue;
+
+        CommandError error = parseSerialKey(key, cmd);
+        if (error == CMD_OK)
+            error = submitCommand(cmd);
+        if (error != CMD_OK)
         {
-        case 'c':
-            stopMovement();
-            delay(1000); // Small delay to ensure stop command is processed
-            calibrateAll();
-            Serial.println("Recalibrated gyro and accelerometer.");
-        case 'v':
-            targetAngle += 0.1; // Increase target angle by 0.1 degree
-            Serial.println("Target angle increased to " + String(targetAngle) + " degrees.");
-        case 'b':
-            targetAngle -= 0.1; // Decrease target angle by 0.1 degree
-            Serial.println("Target angle decreased to " + String(targetAngle) + " degrees.");
-        case 't':
-            deadBand += 1; // Increase deadband by 1 degree
-            Serial.println("Deadband increased to " + String(deadBand) + " degrees.");
-        case 'g':
-            deadBand -= 1; // Decrease deadband by 1 degree
-            if (deadBand < 0)
-                deadBand = 0; // Prevent negative deadband
-            Serial.println("Deadband decreased to " + String(deadBand) + " degrees.");
-        case 'f':
-            moveForward();
-            break;
-        case 'l':
-            turnLeft();
-            break;
-        case 'r':
-            turnRight();
-            break;
-        case 's':
-            stopMovement();
-            break;
-        case '+':
-            setSpeed(currentSpeed + 10);
-            break;
-        case '-':
-            setSpeed(currentSpeed - 10);
-            break;
-        default:
-            adjustPIDGainsFromSerial(key);
+            Serial.printf("Key '%c': %s\n", key, commandErrorString(error));
         }
     }
 }
 
 ControlParams handleTargetAngle(float targetDelta = 0, float deadbandDelta = 0)
 {
-    ControlParams params;
-    if (targetDelta != 0)
-    {
-        targetAngle += targetDelta;
-        targetAngle = constrain(targetAngle, 70.0, 110.0); // Limit target angle
-        Serial.println("Target angle adjusted to " + String(targetAngle) + " degrees.");
-    }
-    params.targetAngle = targetAngle;
-    if (deadbandDelta != 0)
+    // Adjustments are staged and take effect with the rest of the tuning profile
+    if (targetDelta != 0 || deadbandDelta != 0)
     {
-        deadBand += deadbandDelta;
-        deadBand = constrain(deadBand, 0.0, 10.0); // Limit deadband
-        Serial.println("Deadband adjusted to " + String(deadBand) + " degrees.");
+        // Clamped to the field ranges (target angle 70-110, deadband 0-10)
+        TuningEdit edits[] = {{TUNING_TARGET_ANGLE, targetDelta, true}, {TUNING_DEADBAND, deadbandDelta, true}};
+        TuningProfile tuning;
+        editTuning(edits, 2, &tuning);
+        if (targetDelta != 0)
+            Serial.println("Target angle adjusted to " + String(tuning.targetAngle) + " degrees.");
+        if (deadbandDelta != 0)
+            Serial.println("Deadband adjusted to " + String(tuning.deadBand) + " degrees.");
     }
-    params.deadBand = deadBand;
+
+    ControlParams params;
+    params.targetAngle = activeTuning().targetAngle;
+    params.deadBand = activeTuning().deadBand;
     return params;
 }
 
 
-// Handle robot commands (called from HTTP POST handler)
-void handleRobotCommand(String command, String value)
+// Handle robot commands (called from HTTP POST handler, applied later by the control loop)
+CommandError handleRobotCommand(const char *command, const char *value)
 {
-    Serial.print("Handling robot command: ");
-    Serial.print(command);
-    if (value.length() > 0)
-    {
-        Serial.print(" with value: ");
-        Serial.println(value);
-    }
-    else
-    {
-        Serial.println();
-    }
-
-    if (command == "speed")
-    {
-        int speedValue = value.toInt();
-        setSpeed(speedValue);
-        Serial.println("Speed command processed successfully");
-    }
-    else if (command == "forward")
-    {
-        moveForward();
-        Serial.println("Forward command processed successfully");
-    }
-    else if (command == "backward")
+    ControlCommand cmd;
+    CommandError error = parseTextCommand(command, value, SRC_HTTP, cmd);
+    if (error == CMD_OK)
+        error = submitCommand(cmd);
+    if (error != CMD_OK)
     {
-        moveBackward();
-        Serial.println("Backward command processed successfully");
-    }
-    else if (command == "left")
-    {
-        turnLeft();
-        Serial.println("Left turn command processed successfully");
-    }
-    else if (command == "right")
-    {
-        turnRight();
-        Serial.println("Right turn command processed successfully");
-    }
-    else if (command == "stop")
-    {
-        stopMovement();
-        Serial.println("Stop command processed successfully");
-    }
-    else
-    {
-        Serial.println("Unknown command: " + command);
+        Serial.printf("Robot command '%s': %s\n", command, commandErrorString(error));
     }
+    return error;
 }
 
 // Set speed (0-100) - controls LED brightness for testing
@@ -185,67 +140,47 @@ void setSpeed(int speed)
     Serial.println(")");
 }
 
-void moveForward()
+void adjustSpeed(int delta)
 {
-    Serial.println("Moving forward at speed: " + String(currentSpeed) + "%");
-    int pwmValue = map(currentSpeed, 0, 100, 0, 255);
+    setSpeed(currentSpeed + delta);
+}
 
-    // Set direction: forward
-    digitalWrite(MOTOR_LEFT_FWD, HIGH);
-    digitalWrite(MOTOR_LEFT_REV, LOW);
-    digitalWrite(MOTOR_RIGHT_FWD, HIGH);
-    digitalWrite(MOTOR_RIGHT_REV, LOW);
+// Set the drive setpoints mixed into the balance loop
+// forward: -100 to 100 (% of max lean), yawRate: -100 to 100 (% of max yaw rate, positive turns left)
+void setDriveCommand(float forward, float yawRate)
+{
+    driveCommand.forward = constrain(forward, -100.0, 100.0);
+    driveCommand.yawRate = constrain(yawRate, -100.0, 100.0);
+}
 
-    // Set speed
-    ledcWrite(LEDC_CHANNEL_LEFT, pwmValue);
-    ledcWrite(LEDC_CHANNEL_RIGHT, pwmValue);
+void moveForward()
+{
+    Serial.println("Moving forward at speed: " + String(currentSpeed) + "%");
+    setDriveCommand(currentSpeed, 0);
 }
 
 void moveBackward()
 {
     Serial.println("Moving backward at speed: " + String(currentSpeed) + "%");
-    int pwmValue = map(currentSpeed, 0, 100, 0, 255);
-
-    // Set direction: backward
-    digitalWrite(MOTOR_LEFT_FWD, LOW);
-    digitalWrite(MOTOR_LEFT_REV, HIGH);
-    digitalWrite(MOTOR_RIGHT_FWD, LOW);
-    digitalWrite(MOTOR_RIGHT_REV, HIGH);
-
-    // Set speed
-    ledcWrite(LEDC_CHANNEL_LEFT, pwmValue);
-    ledcWrite(LEDC_CHANNEL_RIGHT, pwmValue);
+    setDriveCommand(-currentSpeed, 0);
 }
 
 void turnLeft()
 {
     Serial.println("Turning left at speed: " + String(currentSpeed) + "%");
-    int pwmValue = map(currentSpeed, 0, 100, 0, 255);
-    // Right motor forward, left motor backward
-    digitalWrite(MOTOR_LEFT_FWD, LOW);
-    digitalWrite(MOTOR_LEFT_REV, HIGH);
-    digitalWrite(MOTOR_RIGHT_FWD, HIGH);
-    digitalWrite(MOTOR_RIGHT_REV, LOW);
-
-    // Set speed
-    ledcWrite(LEDC_CHANNEL_LEFT, pwmValue);
-    ledcWrite(LEDC_CHANNEL_RIGHT, pwmValue);
+    setDriveCommand(0, currentSpeed);
 }
 
 void turnRight()
 {
     Serial.println("Turning right at speed: " + String(currentSpeed) + "%");
-    int pwmValue = map(currentSpeed, 0, 100, 0, 255);
-
-    // Left motor forward, right motor backward
-    digitalWrite(MOTOR_LEFT_FWD, HIGH);
-    digitalWrite(MOTOR_LEFT_REV, LOW);
-    digitalWrite(MOTOR_RIGHT_FWD, LOW);
-    digitalWrite(MOTOR_RIGHT_REV, HIGH);
+    setDriveCommand(0, -currentSpeed);
+}
 
-    // Set speed
-    ledcWrite(LEDC_CHANNEL_LEFT, pwmValue);
-    ledcWrite(LEDC_CHANNEL_RIGHT, pwmValue);
+// Clear drive setpoints, the balance loop keeps holding the robot upright
+void stopDriving()
+{
+    setDriveCommand(0, 0);
 }
 
 void stopMovement()
@@ -260,74 +195,123 @@ void stopMovement()
 
     ledcWrite(LEDC_CHANNEL_LEFT, 0);
     ledcWrite(LEDC_CHANNEL_RIGHT, 0);
+
+    leftMotor.duty = 0;
+    leftMotor.holdTicks = 0;
+    leftMotor.stopTicks = 0;
+    rightMotor.duty = 0;
+    rightMotor.holdTicks = 0;
+    rightMotor.stopTicks = 0;
 }
 
-void setMotorSpeeds(int leftSpeed, int rightSpeed)
+// Put the H-bridge into its idle state: both inputs LOW coasts, both HIGH brakes.
+// The enable/PWM pin is driven fully on while braking so L298-style bridges short the motor.
+static void idleMotor(MotorChannel &motor, MotorStopMode mode)
 {
-    // Constrain speeds to -100 to 100
-    leftSpeed = constrain(leftSpeed, -100, 100);
-    rightSpeed = constrain(rightSpeed, -100, 100);
+    if (mode == MOTOR_BRAKE)
+    {
+        digitalWrite(motor.fwdPin, HIGH);
+        digitalWrite(motor.revPin, HIGH);
+        ledcWrite(motor.ledcChannel, 255);
+    }
+    else
+    {
+        digitalWrite(motor.fwdPin, LOW);
+        digitalWrite(motor.revPin, LOW);
+        ledcWrite(motor.ledcChannel, 0);
+    }
+}
 
-    // Convert to PWM values (0-255)
-    int leftPWM = map(abs(leftSpeed), 0, 100, 0, 255);
-    int rightPWM = map(abs(rightSpeed), 0, 100, 0, 255);
+// Duties actually applied after slew limiting (-100 to 100)
+void getMotorDuties(int &left, int &right)
+{
+    left = leftMotor.duty;
+    right = rightMotor.duty;
+}
 
-    // Set directions and speeds for left motor
-    if (leftSpeed > 0)
+// Move one motor towards the requested duty, honouring slew limit and reversal policy
+static void driveMotor(MotorChannel &motor, int target)
+{
+    // Finish any brake/coast interval started by a direction reversal
+    if (motor.holdTicks > 0)
     {
-        digitalWrite(MOTOR_LEFT_FWD, HIGH);
-        digitalWrite(MOTOR_LEFT_REV, LOW);
+        motor.holdTicks--;
+        idleMotor(motor, motorConfig.reversalPolicy == REVERSE_BRAKE ? MOTOR_BRAKE : MOTOR_COAST);
+        return;
     }
-    else if (leftSpeed < 0)
+
+    int next = target;
+    if (motorConfig.slewRate > 0)
     {
-        digitalWrite(MOTOR_LEFT_FWD, LOW);
-        digitalWrite(MOTOR_LEFT_REV, HIGH);
+        next = constrain(target, motor.duty - motorConfig.slewRate, motor.duty + motorConfig.slewRate);
     }
-    else
+
+    // Direction reversal: stop at zero and hold for brakeTicks before driving the other way
+    bool reversing = (motor.duty > 0 && next < 0) || (motor.duty < 0 && next > 0);
+    if (reversing && motorConfig.reversalPolicy != REVERSE_IMMEDIATE)
     {
-        digitalWrite(MOTOR_LEFT_FWD, LOW);
-        digitalWrite(MOTOR_LEFT_REV, LOW);
+        motor.duty = 0;
+        motor.holdTicks = motorConfig.brakeTicks;
+        idleMotor(motor, motorConfig.reversalPolicy == REVERSE_BRAKE ? MOTOR_BRAKE : MOTOR_COAST);
+        return;
     }
-    ledcWrite(LEDC_CHANNEL_LEFT, leftPWM);
 
-    // Set directions and speeds for right motor
-    if (rightSpeed > 0)
+    // Braking is only a short pulse when the duty reaches zero; holding the
+    // windings shorted would turn every zero PID output into hard damping
+    if (next == 0 && motor.duty != 0)
+        motor.stopTicks = motorConfig.brakeTicks;
+
+    motor.duty = next;
+    if (next > 0)
     {
-        digitalWrite(MOTOR_RIGHT_FWD, HIGH);
-        digitalWrite(MOTOR_RIGHT_REV, LOW);
+        digitalWrite(motor.fwdPin, HIGH);
+        digitalWrite(motor.revPin, LOW);
     }
-    else if (rightSpeed < 0)
+    else if (next < 0)
     {
-        digitalWrite(MOTOR_RIGHT_FWD, LOW);
-        digitalWrite(MOTOR_RIGHT_REV, HIGH);
+        digitalWrite(motor.fwdPin, LOW);
+        digitalWrite(motor.revPin, HIGH);
     }
     else
     {
-        digitalWrite(MOTOR_RIGHT_FWD, LOW);
-        digitalWrite(MOTOR_RIGHT_REV, LOW);
+        bool braking = motorConfig.stopMode == MOTOR_BRAKE && motor.stopTicks > 0;
+        if (motor.stopTicks > 0)
+            motor.stopTicks--;
+        idleMotor(motor, braking ? MOTOR_BRAKE : MOTOR_COAST);
+        return;
     }
-    ledcWrite(LEDC_CHANNEL_RIGHT, rightPWM);
+    ledcWrite(motor.ledcChannel, map(abs(next), 0, 100, 0, 255));
+}
+
+void setMotorSpeeds(int leftSpeed, int rightSpeed)
+{
+    // Constrain speeds to -100 to 100
+    leftSpeed = constrain(leftSpeed, -100, 100);
+    rightSpeed = constrain(rightSpeed, -100, 100);
+
+    driveMotor(leftMotor, leftSpeed);
+    driveMotor(rightMotor, rightSpeed);
 
     // Serial.printf("Motor speeds set: Left=%d, Right=%d\n", leftSpeed, rightSpeed);
 }
 
+// Drive the motors open-loop (robot must be supported, balance loop not running)
 void motorTest()
 {
     // Test sequence: forward, backward, left, right, stop
-    setSpeed(50);
-    moveForward();
+    setMotorSpeeds(50, 50);
     delay(2000);
     stopMovement();
     delay(1000);
-    moveBackward();
+    setMotorSpeeds(-50, -50);
     delay(2000);
     stopMovement();
     delay(1000);
-    turnLeft();
+    setMotorSpeeds(-50, 50);
     delay(2000);
     stopMovement();
     delay(1000);
-    turnRight();
+    setMotorSpeeds(50, -50);
     delay(2000);
     stopMovement();
     delay(3000);
@@ -4,26 +4,61 @@
 #include <Arduino.h>
 #include "control/input_controller.h"
 #include "self_balancing/balance.h"
+#include "control/commands.h"
 
 struct ControlParams {
     float targetAngle;
     float deadBand;
 };
 
+// What the H-bridge does when a motor is commanded to zero
+enum MotorStopMode {
+    MOTOR_COAST, // Both inputs LOW, motor spins freely
+    MOTOR_BRAKE  // Both inputs HIGH (windings shorted) for brakeTicks, then coast
+};
+
+// What the H-bridge does when the commanded direction flips
+enum ReversalPolicy {
+    REVERSE_IMMEDIATE, // Drive straight into the new direction
+    REVERSE_COAST,     // Coast for brakeTicks, then reverse
+    REVERSE_BRAKE      // Brake for brakeTicks, then reverse
+};
+
+struct MotorConfig {
+    MotorStopMode stopMode;
+    ReversalPolicy reversalPolicy;
+    int slewRate;   // Max duty change per control tick (%), 0 = unlimited
+    int brakeTicks; // Control ticks spent braking/coasting on a stop or reversal
+};
+
+extern MotorConfig motorConfig;
+
+// Drive setpoints mixed into the balance loop
+struct DriveCommand {
+    float forward; // -100 to 100, % of max lean (forward velocity setpoint)
+    float yawRate; // -100 to 100, % of max yaw rate, positive turns left
+};
+
+extern DriveCommand driveCommand;
+
 // Control commands
 void initController();
 void setSpeed(int speed);  // 0-100
+void adjustSpeed(int delta);
 void moveForward();
 void moveBackward();
 void motorTest();
 void turnLeft();
 void turnRight();
 void stopMovement();
+void stopDriving();
+void setDriveCommand(float forward, float yawRate);
 void setMotorSpeeds(int leftSpeed, int rightSpeed);  // -100 to 100
+void getMotorDuties(int &left, int &right);
 ControlParams handleTargetAngle(float targetDelta, float deadbandDelta); // Adjust target angle by delta
 void handleKeyboardInputs();
 
 // HTTP command handling
-void handleRobotCommand(String command, String value);
+CommandError handleRobotCommand(const char *command, const char *value);
 
 #endif
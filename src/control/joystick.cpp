@@ -0,0 +1,120 @@
+#include "joystick.h"
+#include "input_controller.h"
+#include "telemetry/latency.h"
+
+// No frame for this long while driving stops the robot (about 10 frames at 40 Hz)
+const uint32_t JOYSTICK_TIMEOUT_US = 250000;
+
+// A frame not actuated within this long (robot disarmed) is left out of the latency figures
+const uint32_t JOYSTICK_ACTUATION_TIMEOUT_US = 100000;
+
+JoystickStats joystickStats = {0, 0, 0, 0, 0, 0, 0, false};
+
+// Single-slot mailbox, written by the WebSocket task and taken by the drive loop
+struct JoystickSlot
+{
+    uint16_t seq;
+    int8_t throttle;
+    int8_t yaw;
+    uint32_t originUs;
+    uint32_t receivedUs;
+    bool fresh;
+};
+
+static JoystickSlot joystickSlot = {0, 0, 0, 0, 0, false};
+
+// Last applied frame waiting for the next PWM update (control loop task only)
+static LatencyTrace pendingTrace;
+static bool tracePending = false;
+static uint32_t joystickClient = 0;
+static bool joystickSeqValid = false;
+static volatile uint32_t lastFrameUs = 0;
+static portMUX_TYPE joystickMux = portMUX_INITIALIZER_UNLOCKED;
+
+bool handleJoystickFrame(uint32_t clientId, const uint8_t *data, size_t len)
+{
+    if (len != sizeof(JoystickFrame))
+        return false;
+
+    JoystickFrame frame;
+    memcpy(&frame, data, sizeof(frame));
+    if (frame.magic != JOYSTICK_MAGIC || frame.version != JOYSTICK_VERSION)
+        return false;
+
+    uint32_t now = micros();
+    portENTER_CRITICAL(&joystickMux);
+    // A new client takes over the stream with whatever sequence it starts at
+    bool newer = !joystickSeqValid || clientId != joystickClient || (int16_t)(frame.seq - joystickSlot.seq) > 0;
+    if (newer)
+    {
+        if (joystickSlot.fresh)
+            joystickStats.overwritten++;
+        joystickSlot.seq = frame.seq;
+        joystickSlot.throttle = constrain(frame.throttle, -100, 100);
+        joystickSlot.yaw = constrain(frame.yaw, -100, 100);
+        joystickSlot.originUs = frame.originUs;
+        joystickSlot.receivedUs = now;
+        joystickSlot.fresh = true;
+        joystickClient = clientId;
+        joystickSeqValid = true;
+        joystickStats.frames++;
+        lastFrameUs = now;
+    }
+    else
+    {
+        joystickStats.stale++;
+    }
+    portEXIT_CRITICAL(&joystickMux);
+    return true;
+}
+
+void applyJoystick()
+{
+    JoystickSlot slot;
+    portENTER_CRITICAL(&joystickMux);
+    slot = joystickSlot;
+    joystickSlot.fresh = false;
+    portEXIT_CRITICAL(&joystickMux);
+
+    uint32_t now = micros();
+    if (slot.fresh)
+    {
+        uint32_t age = now - slot.receivedUs;
+        joystickStats.lastAgeUs = age;
+        if (age > joystickStats.maxAgeUs)
+            joystickStats.maxAgeUs = age;
+        joystickStats.lastSeq = slot.seq;
+        // A centred stick is a normal release: the dashboard stops sending after a few
+        // of these, so only a stream that goes quiet while driving counts as a timeout
+        bool driving = slot.throttle != 0 || slot.yaw != 0;
+        if (driving && !joystickStats.active)
+            SERIAL_PRINTLN("Joystick stream started");
+        joystickStats.active = driving;
+        setDriveCommand(slot.throttle, slot.yaw);
+
+        pendingTrace.originUs = slot.originUs;
+        pendingTrace.receivedUs = slot.receivedUs;
+        pendingTrace.appliedUs = now;
+        tracePending = true;
+        return;
+    }
+
+    if (joystickStats.active && now - lastFrameUs > JOYSTICK_TIMEOUT_US)
+    {
+        joystickStats.active = false;
+        joystickStats.timeouts++;
+        stopDriving();
+        SERIAL_PRINTLN("Joystick stream timed out, stopping");
+    }
+}
+
+void joystickActuated()
+{
+    if (!tracePending)
+        return;
+    tracePending = false;
+
+    pendingTrace.actuatedUs = micros();
+    if (pendingTrace.actuatedUs - pendingTrace.appliedUs < JOYSTICK_ACTUATION_TIMEOUT_US)
+        recordLatency(LATENCY_DRIVE, pendingTrace);
+}
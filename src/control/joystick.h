@@ -0,0 +1,47 @@
+#ifndef JOYSTICK_H
+#define JOYSTICK_H
+
+#include <Arduino.h>
+
+// Analog drive stream from the dashboard: small binary WebSocket frames at
+// 30-50 Hz. Only the newest frame is kept; the drive loop applies it and stops
+// the robot when the stream goes quiet.
+
+// Wire format, little endian
+struct __attribute__((packed)) JoystickFrame
+{
+    uint8_t magic;    // JOYSTICK_MAGIC
+    uint8_t version;  // JOYSTICK_VERSION
+    uint16_t seq;     // Incremented per frame by the sender, wraps
+    int8_t throttle;  // -100 to 100, % of max forward speed
+    int8_t yaw;       // -100 to 100, % of max yaw rate, positive turns left
+    uint32_t originUs; // Sender's time of the input in robot micros() (clock offset from ping/pong), 0 if unknown
+};
+
+const uint8_t JOYSTICK_MAGIC = 'J';
+const uint8_t JOYSTICK_VERSION = 2;
+
+struct JoystickStats
+{
+    uint32_t frames;      // Accepted frames
+    uint32_t stale;       // Out of order or duplicate, dropped
+    uint32_t overwritten; // Replaced by a newer frame before the drive loop ran
+    uint32_t timeouts;    // Stream went quiet while driving
+    uint32_t lastAgeUs;   // Receive to apply, for the last applied frame
+    uint32_t maxAgeUs;
+    uint16_t lastSeq;
+    bool active;          // Frames arriving with a non-zero command
+};
+
+extern JoystickStats joystickStats;
+
+// WebSocket task: validate and keep the newest frame, false if malformed
+bool handleJoystickFrame(uint32_t clientId, const uint8_t *data, size_t len);
+
+// Drive loop: apply the newest frame, or stop driving once the stream times out
+void applyJoystick();
+
+// Attitude loop, after the motors were updated: closes the latency trace of the last applied frame
+void joystickActuated();
+
+#endif
@@ -0,0 +1,51 @@
+#include "trajectory.h"
+
+void initProfile(SetpointProfile &profile, float value, float maxRate, float maxAccel)
+{
+    profile.maxRate = maxRate;
+    profile.maxAccel = maxAccel;
+    resetProfile(profile, value);
+}
+
+// Jump straight to a value with no motion in progress
+void resetProfile(SetpointProfile &profile, float value)
+{
+    profile.target = value;
+    profile.value = value;
+    profile.velocity = 0.0;
+}
+
+// Advance the profile one tick towards target
+float updateProfile(SetpointProfile &profile, float target, float dt)
+{
+    profile.target = target;
+    if (dt <= 0)
+        return profile.value;
+
+    float remaining = target - profile.value;
+
+    // Fastest rate from which we can still stop at the target. This is the
+    // discrete form of sqrt(2*a*d): braking happens in maxChange steps, each
+    // held for a whole tick, and the continuous curve overshoots by about
+    // one tick of travel.
+    float maxChange = profile.maxAccel * dt;
+    float halfChange = maxChange / 2.0;
+    float stoppingRate = sqrt(halfChange * halfChange + 2.0 * profile.maxAccel * abs(remaining)) - halfChange;
+    float desiredRate = min(profile.maxRate, stoppingRate);
+    if (remaining < 0)
+        desiredRate = -desiredRate;
+
+    profile.velocity = constrain(desiredRate, profile.velocity - maxChange, profile.velocity + maxChange);
+
+    float step = profile.velocity * dt;
+    if (abs(step) >= abs(remaining) && abs(profile.velocity) <= maxChange)
+    {
+        // Close enough to land exactly on the target this tick
+        resetProfile(profile, target);
+    }
+    else
+    {
+        profile.value += step;
+    }
+    return profile.value;
+}
@@ -0,0 +1,20 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <Arduino.h>
+
+// Acceleration-limited setpoint profile: turns step requests into a smooth
+// trapezoidal ramp that the controllers can follow without discontinuities
+struct SetpointProfile {
+    float target;   // Requested setpoint
+    float value;    // Profiled setpoint fed to the controller
+    float velocity; // Current rate of change (units/s)
+    float maxRate;  // Rate limit (units/s)
+    float maxAccel; // Acceleration limit (units/s^2)
+};
+
+void initProfile(SetpointProfile &profile, float value, float maxRate, float maxAccel);
+void resetProfile(SetpointProfile &profile, float value);
+float updateProfile(SetpointProfile &profile, float target, float dt);
+
+#endif
@@ -0,0 +1,328 @@
+#include "tuning.h"
+#include <LittleFS.h>
+#include <Preferences.h>
+
+// The working profile is written to NVS only once edits have stopped for this
+// long, so dragging a slider costs one flash write instead of dozens
+const uint32_t TUNING_SAVE_DELAY_MS = 2000;
+const uint32_t TUNING_WRITER_PERIOD_MS = 500;
+
+const uint32_t TUNING_MAGIC = 0x454E5554; // "TUNE"
+const uint16_t TUNING_VERSION = 1;
+
+// Stored profile, little endian
+struct __attribute__((packed)) TuningRecord
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size; // sizeof(TuningProfile)
+    TuningProfile profile;
+};
+
+static const TuningProfile DEFAULT_TUNING = {5.0, 0.0, 0.0, 0, 87.0, 0.0, 0.9, 0.9};
+
+const TuningField TUNING_FIELDS[] = {
+    {"kp", offsetof(TuningProfile, kp), 0, 500},
+    {"ki", offsetof(TuningProfile, ki), 0, 100},
+    {"kd", offsetof(TuningProfile, kd), 0, 100},
+    {"base-speed", offsetof(TuningProfile, baseSpeed), 0, 100},
+    {"target-angle", offsetof(TuningProfile, targetAngle), 70, 110},
+    {"deadband", offsetof(TuningProfile, deadBand), 0, 10},
+    {"derivative-filter", offsetof(TuningProfile, derivativeFilter), 0, 0.99},
+    {"output-filter", offsetof(TuningProfile, outputFilter), 0, 0.99},
+};
+
+const int TUNING_FIELD_COUNT = sizeof(TUNING_FIELDS) / sizeof(TUNING_FIELDS[0]);
+
+static_assert(sizeof(TUNING_FIELDS) / sizeof(TUNING_FIELDS[0]) == TUNING_OUTPUT_FILTER + 1, "TUNING_FIELDS must follow TuningFieldId");
+
+// Double buffer: the control loop reads tuningBuffers[activeIndex], editTuning()
+// writes the other one, and swapTuning() flips them between two ticks
+static TuningProfile tuningBuffers[2];
+static volatile uint8_t activeIndex = 0;
+static volatile bool tuningPending = false;
+static portMUX_TYPE tuningMux = portMUX_INITIALIZER_UNLOCKED;
+
+static char profileName[TUNING_NAME_SIZE] = "";
+static volatile bool profileModified = false;
+
+// NVS write coalescing
+static volatile bool tuningDirty = false;
+static volatile uint32_t tuningChangedMs = 0;
+static Preferences tuningPrefs;
+
+static bool validRecord(const TuningRecord &record)
+{
+    return record.magic == TUNING_MAGIC && record.version == TUNING_VERSION && record.size == sizeof(TuningProfile);
+}
+
+static void fillRecord(TuningRecord &record, const TuningProfile &profile)
+{
+    record.magic = TUNING_MAGIC;
+    record.version = TUNING_VERSION;
+    record.size = sizeof(TuningProfile);
+    record.profile = profile;
+}
+
+static void saveWorkingProfile()
+{
+    TuningRecord record;
+    fillRecord(record, latestTuning());
+
+    tuningPrefs.begin("tuning", false);
+    tuningPrefs.putBytes("active", &record, sizeof(record));
+    tuningPrefs.putString("name", profileName);
+    tuningPrefs.putBool("modified", profileModified);
+    tuningPrefs.end();
+}
+
+// Low-priority writer on core 0, away from the control loop
+static void tuningWriterTask(void *param)
+{
+    while (true)
+    {
+        vTaskDelay(pdMS_TO_TICKS(TUNING_WRITER_PERIOD_MS));
+        if (!tuningDirty || millis() - tuningChangedMs < TUNING_SAVE_DELAY_MS)
+            continue;
+
+        tuningDirty = false;
+        saveWorkingProfile();
+    }
+}
+
+void initTuning()
+{
+    TuningProfile profile = DEFAULT_TUNING;
+
+    TuningRecord record;
+    tuningPrefs.begin("tuning", true);
+    if (tuningPrefs.getBytes("active", &record, sizeof(record)) == sizeof(record) && validRecord(record))
+    {
+        profile = record.profile;
+        strlcpy(profileName, tuningPrefs.getString("name", "").c_str(), sizeof(profileName));
+        profileModified = tuningPrefs.getBool("modified", false);
+        Serial.printf("Tuning restored: %s%s\n", profileName[0] ? profileName : "(unnamed)", profileModified ? " (modified)" : "");
+    }
+    tuningPrefs.end();
+
+    tuningBuffers[0] = profile;
+    tuningBuffers[1] = profile;
+    activeIndex = 0;
+    tuningPending = true; // Mirrored into the controller on the first swap
+
+    xTaskCreatePinnedToCore(tuningWriterTask, "tuning", 3072, NULL, 1, NULL, 0);
+}
+
+const TuningProfile &activeTuning()
+{
+    return tuningBuffers[activeIndex];
+}
+
+bool swapTuning()
+{
+    bool swapped = false;
+    portENTER_CRITICAL(&tuningMux);
+    if (tuningPending)
+    {
+        activeIndex ^= 1;
+        tuningPending = false;
+        swapped = true;
+    }
+    portEXIT_CRITICAL(&tuningMux);
+    return swapped;
+}
+
+// Callers hold tuningMux
+static const TuningProfile &latestLocked()
+{
+    return tuningBuffers[tuningPending ? activeIndex ^ 1 : activeIndex];
+}
+
+static void stageLocked(const TuningProfile &profile)
+{
+    // After a swap the inactive buffer holds the previous profile, so it is always written whole
+    tuningBuffers[activeIndex ^ 1] = profile;
+    tuningPending = true;
+}
+
+static void markTuningChanged()
+{
+    tuningChangedMs = millis();
+    tuningDirty = true;
+}
+
+TuningProfile latestTuning()
+{
+    portENTER_CRITICAL(&tuningMux);
+    TuningProfile profile = latestLocked();
+    portEXIT_CRITICAL(&tuningMux);
+    return profile;
+}
+
+bool editTuning(const TuningEdit *edits, int count, TuningProfile *result)
+{
+    bool ok = true;
+    portENTER_CRITICAL(&tuningMux);
+    TuningProfile profile = latestLocked();
+    for (int i = 0; i < count && ok; i++)
+    {
+        const TuningField &spec = TUNING_FIELDS[edits[i].field];
+        float value = edits[i].value;
+        if (edits[i].delta)
+            value = constrain(tuningField(profile, edits[i].field) + value, spec.minValue, spec.maxValue);
+        ok = setTuningField(profile, edits[i].field, value);
+    }
+    if (ok)
+        stageLocked(profile);
+    portEXIT_CRITICAL(&tuningMux);
+
+    if (!ok)
+        return false;
+    markTuningChanged();
+    profileModified = true;
+    if (result != NULL)
+        *result = profile;
+    return true;
+}
+
+float tuningField(const TuningProfile &profile, int field)
+{
+    return *(const float *)((const uint8_t *)&profile + TUNING_FIELDS[field].offset);
+}
+
+bool setTuningField(TuningProfile &profile, int field, float value)
+{
+    const TuningField &spec = TUNING_FIELDS[field];
+    if (isnan(value) || value < spec.minValue || value > spec.maxValue)
+        return false;
+    *(float *)((uint8_t *)&profile + spec.offset) = value;
+    return true;
+}
+
+int findTuningField(const char *name)
+{
+    for (int i = 0; i < TUNING_FIELD_COUNT; i++)
+    {
+        if (strcmp(TUNING_FIELDS[i].name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// Letters, digits, '-' and '_' only, so a name is always a safe file name
+bool isTuningProfileName(const char *name)
+{
+    size_t len = strlen(name);
+    if (len == 0 || len >= TUNING_NAME_SIZE)
+        return false;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '-' && name[i] != '_')
+            return false;
+    }
+    return true;
+}
+
+static void profilePath(char *path, size_t size, const char *name)
+{
+    snprintf(path, size, "%s/%s.bin", TUNING_DIR, name);
+}
+
+bool readTuningProfile(const char *name, TuningProfile &profile)
+{
+    if (!isTuningProfileName(name))
+        return false;
+
+    char path[40];
+    profilePath(path, sizeof(path), name);
+    File file = LittleFS.open(path, "r");
+    if (!file)
+        return false;
+
+    TuningRecord record;
+    bool ok = file.read((uint8_t *)&record, sizeof(record)) == sizeof(record) && validRecord(record);
+    file.close();
+    if (ok)
+        profile = record.profile;
+    return ok;
+}
+
+bool saveTuningProfile(const char *name)
+{
+    if (!isTuningProfileName(name))
+        return false;
+
+    TuningRecord record;
+    fillRecord(record, latestTuning());
+
+    char path[40];
+    profilePath(path, sizeof(path), name);
+    LittleFS.mkdir(TUNING_DIR);
+    File file = LittleFS.open(path, "w");
+    if (!file)
+        return false;
+    bool ok = file.write((const uint8_t *)&record, sizeof(record)) == sizeof(record);
+    file.close();
+    if (!ok)
+    {
+        LittleFS.remove(path);
+        return false;
+    }
+
+    strlcpy(profileName, name, sizeof(profileName));
+    profileModified = false;
+    markTuningChanged();
+    return true;
+}
+
+bool loadTuningProfile(const char *name)
+{
+    TuningProfile profile;
+    if (!readTuningProfile(name, profile))
+        return false;
+
+    portENTER_CRITICAL(&tuningMux);
+    stageLocked(profile);
+    portEXIT_CRITICAL(&tuningMux);
+    markTuningChanged();
+    strlcpy(profileName, name, sizeof(profileName));
+    profileModified = false;
+    return true;
+}
+
+int listTuningProfiles(char names[][TUNING_NAME_SIZE], int maxNames)
+{
+    int n = 0;
+    File dir = LittleFS.open(TUNING_DIR);
+    if (!dir || !dir.isDirectory())
+        return 0;
+    File file = dir.openNextFile();
+    while (file && n < maxNames)
+    {
+        const char *name = file.name();
+        const char *ext = strrchr(name, '.');
+        if (ext != NULL && strcmp(ext, ".bin") == 0 && ext - name < TUNING_NAME_SIZE)
+        {
+            memcpy(names[n], name, ext - name);
+            names[n][ext - name] = 0;
+            if (isTuningProfileName(names[n]))
+                n++;
+        }
+        file.close();
+        file = dir.openNextFile();
+    }
+    if (file)
+        file.close();
+    dir.close();
+    return n;
+}
+
+const char *tuningProfileName()
+{
+    return profileName;
+}
+
+bool tuningModified()
+{
+    return profileModified;
+}
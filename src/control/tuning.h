@@ -0,0 +1,82 @@
+#ifndef TUNING_H
+#define TUNING_H
+
+#include <Arduino.h>
+
+// Balance controller tuning, swapped in as a whole between two control ticks.
+// Edits are staged into a second buffer from any task and picked up by the
+// control loop at the start of its next tick, so it never runs on a half-applied set.
+struct TuningProfile
+{
+    float kp;
+    float ki;
+    float kd;
+    float baseSpeed;        // Motor % added to the PID output
+    float targetAngle;      // Upright angle (degrees)
+    float deadBand;         // Error ignored around the setpoint (degrees)
+    float derivativeFilter; // Low-pass weight kept from the previous D term (0-1)
+    float outputFilter;     // Low-pass weight kept from the previous PID output (0-1)
+};
+
+// Editable fields by name, for the WebSocket API and profile diffs
+enum TuningFieldId
+{
+    TUNING_KP,
+    TUNING_KI,
+    TUNING_KD,
+    TUNING_BASE_SPEED,
+    TUNING_TARGET_ANGLE,
+    TUNING_DEADBAND,
+    TUNING_DERIVATIVE_FILTER,
+    TUNING_OUTPUT_FILTER
+};
+
+struct TuningField
+{
+    const char *name;
+    size_t offset;
+    float minValue;
+    float maxValue;
+};
+
+extern const TuningField TUNING_FIELDS[];
+extern const int TUNING_FIELD_COUNT;
+
+// One field change for editTuning(): a new value, or a delta clamped to the field range
+struct TuningEdit
+{
+    int field; // TuningFieldId
+    float value;
+    bool delta;
+};
+
+// Named profiles live in LittleFS as TUNING_DIR/<name>.bin, the working profile in NVS
+const char *const TUNING_DIR = "/tuning";
+const int TUNING_NAME_SIZE = 16;
+const int MAX_TUNING_PROFILES = 16;
+
+void initTuning(); // Restores the working profile from NVS and starts the writer task
+
+const TuningProfile &activeTuning(); // Control loop only
+bool swapTuning();                   // Control loop only, at the start of a tick; true if a new profile was applied
+TuningProfile latestTuning();        // Staged profile if any, otherwise the active one
+
+// Applies the edits to latestTuning() and stages the result as one step under the
+// tuning lock, so edits from different tasks never overwrite each other. Nothing is
+// staged and false is returned if a new value is out of range. Any task.
+bool editTuning(const TuningEdit *edits, int count, TuningProfile *result = NULL);
+
+float tuningField(const TuningProfile &profile, int field);
+bool setTuningField(TuningProfile &profile, int field, float value); // False if out of range
+int findTuningField(const char *name);
+
+// Named profiles
+bool isTuningProfileName(const char *name);
+bool readTuningProfile(const char *name, TuningProfile &profile);
+bool saveTuningProfile(const char *name); // Stores latestTuning()
+bool loadTuningProfile(const char *name); // Stages the stored profile
+int listTuningProfiles(char names[][TUNING_NAME_SIZE], int maxNames);
+const char *tuningProfileName();          // Last loaded or saved profile, "" if never
+bool tuningModified();                    // Edited since the last load or save
+
+#endif
@@ -0,0 +1,188 @@
+#include "encoder.h"
+
+#ifndef ENCODER_FAKE
+#include "driver/pcnt.h"
+#endif
+
+const float MM_PER_COUNT = PI * WHEEL_DIAMETER_MM / ENCODER_COUNTS_PER_REV;
+const float VELOCITY_FILTER = 0.7; // Low-pass on wheel velocity (0 = no filtering)
+
+static WheelOdometry odometry = {0, 0, 0.0, 0.0, 0.0, 0.0, 0.0};
+static unsigned long lastUpdateTime = 0;
+
+// Counts per wheel, taken only while that motor is driven, before the encoders
+// are trusted. PCNT pulls its inputs up, so unfitted encoders never count.
+const int32_t ENCODER_DETECT_COUNTS = 50;
+static int32_t detectLeft = 0;
+static int32_t detectRight = 0;
+
+#ifndef ENCODER_FAKE
+
+// The PCNT counter is 16 bit and resets to zero at either limit,
+// so raw readings are unwrapped modulo PCNT_LIMIT into a 32 bit count
+const int16_t PCNT_LIMIT = 30000;
+
+static int16_t lastRawLeft = 0;
+static int16_t lastRawRight = 0;
+
+// Full x4 quadrature decoding: each channel counts the edges of one
+// signal, with the other signal's level selecting the direction
+static void configurePCNT(pcnt_unit_t unit, int pinA, int pinB)
+{
+    pcnt_config_t config = {};
+    config.unit = unit;
+    config.counter_h_lim = PCNT_LIMIT;
+    config.counter_l_lim = -PCNT_LIMIT;
+
+    config.channel = PCNT_CHANNEL_0;
+    config.pulse_gpio_num = pinA;
+    config.ctrl_gpio_num = pinB;
+    config.pos_mode = PCNT_COUNT_DEC;
+    config.neg_mode = PCNT_COUNT_INC;
+    config.lctrl_mode = PCNT_MODE_REVERSE;
+    config.hctrl_mode = PCNT_MODE_KEEP;
+    pcnt_unit_config(&config);
+
+    config.channel = PCNT_CHANNEL_1;
+    config.pulse_gpio_num = pinB;
+    config.ctrl_gpio_num = pinA;
+    config.pos_mode = PCNT_COUNT_INC;
+    config.neg_mode = PCNT_COUNT_DEC;
+    pcnt_unit_config(&config);
+
+    // Reject glitches shorter than ~1.25us (100 APB cycles)
+    pcnt_set_filter_value(unit, 100);
+    pcnt_filter_enable(unit);
+
+    pcnt_counter_pause(unit);
+    pcnt_counter_clear(unit);
+    pcnt_counter_resume(unit);
+}
+
+static int32_t unwrapDelta(int16_t raw, int16_t &last)
+{
+    int32_t delta = (int32_t)raw - last;
+    if (delta > PCNT_LIMIT / 2)
+        delta -= PCNT_LIMIT;
+    else if (delta < -PCNT_LIMIT / 2)
+        delta += PCNT_LIMIT;
+    last = raw;
+    return delta;
+}
+
+static void readCountDeltas(int32_t &left, int32_t &right)
+{
+    int16_t rawLeft = 0, rawRight = 0;
+    pcnt_get_counter_value(PCNT_UNIT_0, &rawLeft);
+    pcnt_get_counter_value(PCNT_UNIT_1, &rawRight);
+    left = unwrapDelta(rawLeft, lastRawLeft);
+    right = unwrapDelta(rawRight, lastRawRight);
+}
+
+void initEncoders()
+{
+    configurePCNT(PCNT_UNIT_0, ENCODER_LEFT_A, ENCODER_LEFT_B);
+    configurePCNT(PCNT_UNIT_1, ENCODER_RIGHT_A, ENCODER_RIGHT_B);
+    lastUpdateTime = millis();
+    Serial.println("Wheel encoders initialized (PCNT)");
+}
+
+#else
+
+// Fake encoder: wheel speed follows the commanded duty, or a simulator sets the counts
+const float FAKE_COUNTS_PER_SEC_AT_FULL_DUTY = 6000.0;
+
+static float fakeLeft = 0.0;
+static float fakeRight = 0.0;
+static bool fakeInjected = false;
+static int32_t injectedLeft = 0;
+static int32_t injectedRight = 0;
+
+void setFakeEncoderCounts(int32_t left, int32_t right)
+{
+    injectedLeft = left;
+    injectedRight = right;
+    fakeInjected = true;
+}
+
+static void readFakeCountDeltas(int32_t &left, int32_t &right, float dt, int leftDuty, int rightDuty)
+{
+    if (fakeInjected)
+    {
+        left = injectedLeft - odometry.leftCount;
+        right = injectedRight - odometry.rightCount;
+        return;
+    }
+
+    float prevLeft = fakeLeft, prevRight = fakeRight;
+    fakeLeft += leftDuty / 100.0 * FAKE_COUNTS_PER_SEC_AT_FULL_DUTY * dt;
+    fakeRight += rightDuty / 100.0 * FAKE_COUNTS_PER_SEC_AT_FULL_DUTY * dt;
+    // Round rather than truncate so float drift cannot lose a count
+    left = lround(fakeLeft) - lround(prevLeft);
+    right = lround(fakeRight) - lround(prevRight);
+}
+
+void initEncoders()
+{
+    lastUpdateTime = millis();
+    Serial.println("Wheel encoders initialized (fake)");
+}
+
+#endif
+
+// Update counts, wheel velocities and odometry
+void updateEncoders(int leftDuty, int rightDuty)
+{
+    unsigned long currentTime = millis();
+    float dt = (currentTime - lastUpdateTime) / 1000.0;
+    lastUpdateTime = currentTime;
+
+    int32_t deltaLeft, deltaRight;
+#ifdef ENCODER_FAKE
+    readFakeCountDeltas(deltaLeft, deltaRight, dt, leftDuty, rightDuty);
+#else
+    readCountDeltas(deltaLeft, deltaRight);
+#if ENCODER_RIGHT_INVERT
+    deltaRight = -deltaRight;
+#endif
+#endif
+
+    odometry.leftCount += deltaLeft;
+    odometry.rightCount += deltaRight;
+
+    if (!encodersDetected())
+    {
+        if (leftDuty != 0)
+            detectLeft += abs(deltaLeft);
+        if (rightDuty != 0)
+            detectRight += abs(deltaRight);
+    }
+
+    float leftMM = deltaLeft * MM_PER_COUNT;
+    float rightMM = deltaRight * MM_PER_COUNT;
+    odometry.distance += (leftMM + rightMM) / 2.0;
+    odometry.heading += (rightMM - leftMM) / WHEEL_BASE_MM * 180.0 / PI;
+
+    if (dt > 0)
+    {
+        odometry.leftVelocity = VELOCITY_FILTER * odometry.leftVelocity + (1 - VELOCITY_FILTER) * leftMM / dt;
+        odometry.rightVelocity = VELOCITY_FILTER * odometry.rightVelocity + (1 - VELOCITY_FILTER) * rightMM / dt;
+        odometry.velocity = (odometry.leftVelocity + odometry.rightVelocity) / 2.0;
+    }
+}
+
+const WheelOdometry &getOdometry()
+{
+    return odometry;
+}
+
+void resetOdometry()
+{
+    odometry.distance = 0.0;
+    odometry.heading = 0.0;
+}
+
+bool encodersDetected()
+{
+    return detectLeft >= ENCODER_DETECT_COUNTS && detectRight >= ENCODER_DETECT_COUNTS;
+}
@@ -0,0 +1,48 @@
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include <Arduino.h>
+
+// Quadrature encoder pins (A/B per wheel)
+#define ENCODER_LEFT_A 25
+#define ENCODER_LEFT_B 26
+#define ENCODER_RIGHT_A 27
+#define ENCODER_RIGHT_B 13
+
+// Wheel geometry
+#define ENCODER_COUNTS_PER_REV 1320 // 11 PPR motor x 30:1 gearbox x 4 edges
+#define WHEEL_DIAMETER_MM 65.0
+#define WHEEL_BASE_MM 150.0
+
+// Right motor is mounted mirrored, so its encoder counts the other way
+#define ENCODER_RIGHT_INVERT 1
+
+// Builds without the ESP32 PCNT peripheral (the native test environment, a
+// simulator) use a fake encoder driven by the applied motor duty. Define
+// ENCODER_FAKE to force it on the robot.
+#if !defined(ARDUINO_ARCH_ESP32)
+#define ENCODER_FAKE
+#endif
+
+struct WheelOdometry {
+    int32_t leftCount;
+    int32_t rightCount;
+    float leftVelocity;  // mm/s
+    float rightVelocity; // mm/s
+    float velocity;      // mm/s, average of both wheels
+    float distance;      // mm travelled, average of both wheels
+    float heading;       // degrees, positive turns left
+};
+
+void initEncoders();
+void updateEncoders(int leftDuty, int rightDuty); // Applied duties (-100 to 100), once per drive tick
+const WheelOdometry &getOdometry();
+void resetOdometry();
+bool encodersDetected(); // Both wheels have counted while their motor was driven
+
+#ifdef ENCODER_FAKE
+// Inject counts from a simulator instead of integrating the motor duty
+void setFakeEncoderCounts(int32_t left, int32_t right);
+#endif
+
+#endif
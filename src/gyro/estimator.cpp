@@ -0,0 +1,40 @@
+#include "estimator.h"
+#include <math.h>
+
+// Weight of the integrated gyro angle; the rest comes from the accelerometer
+const float COMPLEMENTARY_ALPHA = 0.8;
+
+// Pitch from the accelerometer, -180 to 180 degrees
+static float accelPitch(const ImuSample &sample)
+{
+    // Orientation: X down, Y right, Z forward; pitch is the rotation around Y
+    float ax = sample.accel[0] / ACCEL_COUNTS_PER_G;
+    float az = sample.accel[2] / ACCEL_COUNTS_PER_G;
+    return atan2f(-ax, az) * (180.0f / (float)M_PI);
+}
+
+float accelTiltAngle(const ImuSample &sample)
+{
+    return fmodf(accelPitch(sample) + 360.0f, 360.0f);
+}
+
+void resetAngleEstimator(AngleEstimator &estimator, const ImuSample &sample)
+{
+    estimator.angle = accelTiltAngle(sample);
+    estimator.lastTimeUs = sample.timeUs;
+}
+
+float updateAngleEstimator(AngleEstimator &estimator, const ImuSample &sample)
+{
+    float dt = (uint32_t)(sample.timeUs - estimator.lastTimeUs) / 1000000.0f;
+    estimator.lastTimeUs = sample.timeUs;
+
+    float accelAngle = accelPitch(sample);
+
+    // Y axis is the pitch rate, sign flipped to match the accelerometer angle
+    float gyroRate = -(sample.gyro[1] / GYRO_COUNTS_PER_DPS);
+    float angle = COMPLEMENTARY_ALPHA * (estimator.angle + gyroRate * dt) + (1.0f - COMPLEMENTARY_ALPHA) * accelAngle;
+
+    estimator.angle = fmodf(angle + 360.0f, 360.0f);
+    return estimator.angle;
+}
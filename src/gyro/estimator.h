@@ -0,0 +1,35 @@
+#ifndef ESTIMATOR_H
+#define ESTIMATOR_H
+
+#include <stdint.h>
+
+// Tilt estimator as a pure function of recorded IMU samples, shared by the
+// firmware and the host replay tool (tools/imu_replay). No Arduino headers.
+
+// One IMU read in calibrated counts (raw reading minus offsets)
+struct ImuSample
+{
+    uint32_t timeUs;  // micros() when the sample was read
+    int16_t gyro[3];  // 131 counts per deg/s (+-250 deg/s range)
+    int16_t accel[3]; // 16384 counts per g (+-2 g range)
+};
+
+const float GYRO_COUNTS_PER_DPS = 131.0;
+const float ACCEL_COUNTS_PER_G = 16384.0;
+
+struct AngleEstimator
+{
+    float angle;         // Degrees, 0-360, about 87 when upright
+    uint32_t lastTimeUs;
+};
+
+// Tilt from the accelerometer alone (degrees, 0-360)
+float accelTiltAngle(const ImuSample &sample);
+
+// Start from the accelerometer angle of the given sample
+void resetAngleEstimator(AngleEstimator &estimator, const ImuSample &sample);
+
+// Complementary filter step, returns the new angle
+float updateAngleEstimator(AngleEstimator &estimator, const ImuSample &sample);
+
+#endif
@@ -1,15 +1,44 @@
 #include "gyro.h"
+#include "estimator.h"
 GyroOffsets gyroOffsets;
 AccelOffsets accelOffsets;
 
 // Global variables for complementary filter
 float currentAngle = 0.0;
-unsigned long lastAngleTime = 0;
+static AngleEstimator angleEstimator = {0.0, 0};
+ImuSample lastImuSample;
+ImuHealth imuHealth = {0, 0, 0, 0, 0, false};
 
-// Initialize the gyroscope
-void initGyro()
+// Fault handling: recover the bus after a few failed reads, report a fault
+// (the balance loop disarms) when no good sample arrived for a while
+const uint32_t IMU_RECOVER_AFTER_FAILURES = 5;
+const uint32_t IMU_RECOVER_INTERVAL_US = 100000;
+const uint32_t IMU_FAULT_TIMEOUT_US = 50000; // 10 ticks at 200 Hz
+static uint32_t lastRecoveryUs = 0;
+
+// A 14-byte burst takes ~1.5 ms at 100 kHz. The driver's 50 ms default would
+// let one stuck transfer hold the 5 ms control tick for ten periods.
+const uint16_t IMU_I2C_TIMEOUT_MS = 3;
+
+// Recalibration while running, one sample per control tick (see sampleGyroCalibration())
+const uint32_t GYRO_CAL_SETTLE_US = 1000000; // Let the robot come to rest after disarming
+const int GYRO_CAL_SAMPLES = 100;
+static bool gyroCalActive = false;
+static uint32_t gyroCalStartUs = 0;
+static int gyroCalCount = 0;
+static float gyroCalSum[3];
+static int16_t lastRawGyro[3]; // Uncorrected gyro counts of the last good readImuSample()
+
+GyroData lastGyro = {0.0, 0.0, 0.0};
+AccelData lastAccel = {0.0, 0.0, 0.0};
+float lastAccelAngle = 0.0;
+
+// Start the I2C driver, wake the IMU and set its ranges
+static void startImu()
 {
     Wire.begin();
+    Wire.setTimeOut(IMU_I2C_TIMEOUT_MS);
+
     Wire.beginTransmission(GYRO_I2C_ADDRESS);
     Wire.write(0x6B); // Power management register
     Wire.write(0);    // Wake up the gyro
@@ -20,10 +49,45 @@ void initGyro()
     Wire.write(0x1C); // Accel config register
     Wire.write(0);    // 2g range
     Wire.endTransmission();
+}
+
+// Initialize the gyroscope
+void initGyro()
+{
+    startImu();
+    imuHealth.lastGoodUs = micros();
 
     Serial.println("Gyroscope initialized");
 }
 
+// Free a bus held low by a slave stuck mid-byte: clock SCL until SDA is released,
+// send a STOP, then restart the driver and reconfigure the IMU
+static void recoverImuBus()
+{
+    Wire.end();
+
+    pinMode(SDA, INPUT_PULLUP);
+    pinMode(SCL, OUTPUT_OPEN_DRAIN);
+    for (int i = 0; i < 9 && digitalRead(SDA) == LOW; i++)
+    {
+        digitalWrite(SCL, LOW);
+        delayMicroseconds(5);
+        digitalWrite(SCL, HIGH);
+        delayMicroseconds(5);
+    }
+    // STOP: SDA low to high while SCL is high
+    pinMode(SDA, OUTPUT_OPEN_DRAIN);
+    digitalWrite(SDA, LOW);
+    delayMicroseconds(5);
+    digitalWrite(SCL, HIGH);
+    delayMicroseconds(5);
+    digitalWrite(SDA, HIGH);
+    delayMicroseconds(5);
+
+    startImu();
+    imuHealth.recoveries++;
+}
+
 void calibrateAll()
 {
 
@@ -36,6 +100,7 @@ void calibrateGyro(GyroOffsets &offsets)
 {
     const int numSamples = 100;
     float sumX = 0, sumY = 0, sumZ = 0;
+    int goodSamples = 0;
 
     Serial.println("Calibrating gyroscope... Keep the device stationary.");
 
@@ -53,13 +118,24 @@ void calibrateGyro(GyroOffsets &offsets)
             sumX += rawX;
             sumY += rawY;
             sumZ += rawZ;
+            goodSamples++;
+        }
+        else
+        {
+            imuHealth.readErrors++;
         }
         delay(10);
     }
 
-    offsets.x = sumX / numSamples;
-    offsets.y = sumY / numSamples;
-    offsets.z = sumZ / numSamples;
+    // Average only the samples that were actually read
+    if (goodSamples == 0)
+    {
+        Serial.println("Gyro calibration failed: no readings, keeping previous offsets");
+        return;
+    }
+    offsets.x = sumX / goodSamples;
+    offsets.y = sumY / goodSamples;
+    offsets.z = sumZ / goodSamples;
 
     Serial.printf("Gyro offsets: X=%.2f, Y=%.2f, Z=%.2f\n", offsets.x, offsets.y, offsets.z);
 }
@@ -74,44 +150,40 @@ void calibrateAccel(AccelOffsets &offsets)
     Serial.printf("Accel offsets: X=%.2f, Y=%.2f, Z=%.2f\n", offsets.x, offsets.y, offsets.z);
 }
 
-// Read gyroscope data with calibration
-GyroData readGyro(const GyroOffsets &offsets)
+// Start recalibrating the gyro without blocking the caller; accelerometer offsets are set at once
+void startGyroCalibration()
 {
-    GyroData data;
-    Wire.beginTransmission(GYRO_I2C_ADDRESS);
-    Wire.write(0x43); // Starting register for gyro data
-    Wire.endTransmission();
-    Wire.requestFrom(GYRO_I2C_ADDRESS, 6);
-    if (Wire.available() == 6)
-    {
-        int16_t rawX = (Wire.read() << 8 | Wire.read()) - offsets.x;
-        int16_t rawY = (Wire.read() << 8 | Wire.read()) - offsets.y;
-        int16_t rawZ = (Wire.read() << 8 | Wire.read()) - offsets.z;
-        data.x = rawX / 131.0; // Convert to degrees/sec (for 250 deg/s range)
-        data.y = rawY / 131.0;
-        data.z = rawZ / 131.0;
-    }
-    return data;
+    gyroCalActive = true;
+    gyroCalStartUs = micros();
+    gyroCalCount = 0;
+    gyroCalSum[0] = gyroCalSum[1] = gyroCalSum[2] = 0;
+    calibrateAccel(accelOffsets);
+    Serial.println("Calibrating gyroscope... Keep the device stationary.");
 }
 
-// Read accelerometer data with calibration
-AccelData readAccel(const AccelOffsets &offsets)
+bool gyroCalibrating()
 {
-    AccelData data;
-    Wire.beginTransmission(GYRO_I2C_ADDRESS);
-    Wire.write(0x3B); // Starting register for accel data
-    Wire.endTransmission();
-    Wire.requestFrom(GYRO_I2C_ADDRESS, 6);
-    if (Wire.available() == 6)
-    {
-        int16_t rawX = (Wire.read() << 8 | Wire.read()) - offsets.x;
-        int16_t rawY = (Wire.read() << 8 | Wire.read()) - offsets.y;
-        int16_t rawZ = (Wire.read() << 8 | Wire.read()) - offsets.z;
-        data.x = rawX / 16384.0; // Convert to g (for 2g range)
-        data.y = rawY / 16384.0;
-        data.z = rawZ / 16384.0;
-    }
-    return data;
+    return gyroCalActive;
+}
+
+// Call after calculateAngle(); accumulates the sample just read and
+// returns true on the tick the new offsets are applied
+bool sampleGyroCalibration()
+{
+    if (!gyroCalActive || micros() - gyroCalStartUs < GYRO_CAL_SETTLE_US || imuHealth.consecutiveFailures > 0)
+        return false;
+
+    for (int i = 0; i < 3; i++)
+        gyroCalSum[i] += lastRawGyro[i];
+    if (++gyroCalCount < GYRO_CAL_SAMPLES)
+        return false;
+
+    gyroOffsets.x = gyroCalSum[0] / gyroCalCount;
+    gyroOffsets.y = gyroCalSum[1] / gyroCalCount;
+    gyroOffsets.z = gyroCalSum[2] / gyroCalCount;
+    gyroCalActive = false;
+    Serial.printf("Gyro offsets: X=%.2f, Y=%.2f, Z=%.2f\n", gyroOffsets.x, gyroOffsets.y, gyroOffsets.z);
+    return true;
 }
 
 Orientation readOrientation(const GyroData &gyro, const AccelData &accel)
@@ -180,31 +252,94 @@ void adjustGyroOffsets(GyroOffsets &offsets, const GyroData &drift, char ijkl)
     Serial.printf("Adjusted Gyro Offsets: X=%.2f, Y=%.2f, Z=%.2f\n", offsets.x, offsets.y, offsets.z);
 }
 
-// Calculate angle using complementary filter
-// float calculateAngle(AccelData accel, GyroData gyro)
-float calculateAngle()
+// Offset-corrected count, rounded and clamped: a saturated reading minus a
+// negative offset must not overflow the int16_t conversion
+static int16_t correctedCount(int16_t raw, float offset)
 {
-    AccelData accel = readAccel(accelOffsets);
-    GyroData gyro = readGyro(gyroOffsets);
-    unsigned long currentTime = millis();
-    float dt = (currentTime - lastAngleTime) / 1000.0; // Convert to seconds
-    lastAngleTime = currentTime;
+    long value = lroundf(raw - offset);
+    return constrain(value, -32768L, 32767L);
+}
+
+// Read one burst of the 14 accel/temp/gyro registers as calibrated counts.
+// Returns false, leaving sample unchanged, if the read was short.
+bool readImuSample(ImuSample &sample)
+{
+    Wire.beginTransmission(GYRO_I2C_ADDRESS);
+    Wire.write(0x3B); // ACCEL_XOUT_H, followed by TEMP_OUT and GYRO_XOUT
+    Wire.endTransmission();
+    Wire.requestFrom(GYRO_I2C_ADDRESS, 14);
+    if (Wire.available() != 14)
+    {
+        imuHealth.readErrors++;
+        return false;
+    }
+
+    sample.timeUs = micros();
+    int16_t raw[7];
+    for (int i = 0; i < 7; i++)
+    {
+        uint8_t high = Wire.read();
+        raw[i] = high << 8 | Wire.read();
+    }
+    memcpy(lastRawGyro, &raw[4], sizeof(lastRawGyro));
+    sample.accel[0] = correctedCount(raw[0], accelOffsets.x);
+    sample.accel[1] = correctedCount(raw[1], accelOffsets.y);
+    sample.accel[2] = correctedCount(raw[2], accelOffsets.z);
+    sample.gyro[0] = correctedCount(raw[4], gyroOffsets.x);
+    sample.gyro[1] = correctedCount(raw[5], gyroOffsets.y);
+    sample.gyro[2] = correctedCount(raw[6], gyroOffsets.z);
+    return true;
+}
 
-    // Calculate angle from accelerometer (pitch angle)
-    // Orientation: X down, Y right, Z forward
-    // Pitch angle around Y-axis: atan2(Z, X)
-    float accelAngle = atan2(-accel.x, accel.z) * 180.0 / PI;
+// Restart the estimator from the current accelerometer angle
+void resetAngle()
+{
+    readImuSample(lastImuSample);
+    resetAngleEstimator(angleEstimator, lastImuSample);
+    currentAngle = angleEstimator.angle;
+}
 
-    // Integrate gyro rate to get angle change
-    float gyroRate = -gyro.y; // Y-axis for pitch rate
-    float gyroAngleChange = gyroRate * dt;
+// Count a failed read, recover the bus and flag a fault when reads keep failing
+static void handleImuFailure(uint32_t now)
+{
+    imuHealth.consecutiveFailures++;
+    if (imuHealth.consecutiveFailures >= IMU_RECOVER_AFTER_FAILURES && now - lastRecoveryUs >= IMU_RECOVER_INTERVAL_US)
+    {
+        lastRecoveryUs = now;
+        recoverImuBus();
+    }
+    if (!imuHealth.faulted && now - imuHealth.lastGoodUs >= IMU_FAULT_TIMEOUT_US)
+    {
+        imuHealth.faulted = true;
+        imuHealth.faults++;
+    }
+}
 
-    // Complementary filter
-    float alpha = 0.8; // Reduced alpha for faster response to accelerometer
-    currentAngle = alpha * (currentAngle + gyroAngleChange) + (1 - alpha) * accelAngle;
+// Read the IMU and update the tilt estimate (see estimator.cpp).
+// A failed read repeats the last good sample at the current time.
+float calculateAngle()
+{
+    uint32_t now = micros();
+    if (readImuSample(lastImuSample))
+    {
+        imuHealth.consecutiveFailures = 0;
+        imuHealth.lastGoodUs = now;
+        imuHealth.faulted = false;
+    }
+    else
+    {
+        lastImuSample.timeUs = now;
+        handleImuFailure(now);
+    }
 
-    // Normalize angle to 0-360 degrees
-    currentAngle = fmod(currentAngle + 360.0, 360.0);
-    
+    lastGyro.x = lastImuSample.gyro[0] / GYRO_COUNTS_PER_DPS;
+    lastGyro.y = lastImuSample.gyro[1] / GYRO_COUNTS_PER_DPS;
+    lastGyro.z = lastImuSample.gyro[2] / GYRO_COUNTS_PER_DPS;
+    lastAccel.x = lastImuSample.accel[0] / ACCEL_COUNTS_PER_G;
+    lastAccel.y = lastImuSample.accel[1] / ACCEL_COUNTS_PER_G;
+    lastAccel.z = lastImuSample.accel[2] / ACCEL_COUNTS_PER_G;
+    lastAccelAngle = accelTiltAngle(lastImuSample);
+
+    currentAngle = updateAngleEstimator(angleEstimator, lastImuSample);
     return currentAngle;
-}
\ No newline at end of file
+}
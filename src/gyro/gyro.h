@@ -3,6 +3,7 @@
 
 #include <Wire.h>
 #include <Arduino.h>
+#include "estimator.h"
 
 // Gyroscope I2C address
 #define GYRO_I2C_ADDRESS 0x68
@@ -36,19 +37,37 @@ struct Orientation {
     float yaw;   // Rotation around Z-axis
 };
 
+// IMU read health, written by calculateAngle()
+struct ImuHealth
+{
+    uint32_t readErrors;          // Short I2C reads
+    uint32_t consecutiveFailures;
+    uint32_t recoveries;          // Bus recoveries (SCL pulses + driver restart)
+    uint32_t faults;              // Times the IMU went silent past the timeout
+    uint32_t lastGoodUs;
+    bool faulted;                 // No good sample within the timeout, motors must stop
+};
+
 // Function declarations
 void initGyro();
 void calibrateAll();
 void calibrateGyro(GyroOffsets &offsets);
 void calibrateAccel(AccelOffsets &offsets);
-GyroData readGyro(const GyroOffsets &offsets);
-AccelData readAccel(const AccelOffsets &offsets);
+void startGyroCalibration(); // Non-blocking, sampled by the control loop
+bool gyroCalibrating();
+bool sampleGyroCalibration(); // True once the new offsets are applied
 Orientation readOrientation(const GyroData &gyro, const AccelData &accel);
 void adjustGyroOffsets(GyroOffsets &offsets, const GyroData &drift, char ijkl);
+bool readImuSample(ImuSample &sample);
+void resetAngle();
 float calculateAngle();
 
 // Global variables for complementary filter
 extern float currentAngle;
-extern unsigned long lastAngleTime;
+extern ImuHealth imuHealth;
+extern ImuSample lastImuSample; // Raw input of the last calculateAngle(), for recording
+extern GyroData lastGyro; // Last gyro sample used by calculateAngle()
+extern AccelData lastAccel; // Last accelerometer sample used by calculateAngle()
+extern float lastAccelAngle; // Accelerometer-only tilt from the last calculateAngle()
 
 #endif
\ No newline at end of file
@@ -4,62 +4,125 @@
 #include "gyro/gyro.h"
 #include "display/oled.h"
 #include "self_balancing/balance.h"
+#include "control/command_queue.h"
+#include "control/commands.h"
+#include "encoder/encoder.h"
+#include "scheduler/scheduler.h"
+#include "wifi/ws_streams.h"
+#include "boot/boot_timeline.h"
+#include "telemetry/capture.h"
+#include "telemetry/blackbox.h"
+#include "telemetry/metrics.h"
+#include "scheduler/load_shed.h"
+#include "control/tuning.h"
+#include "self_balancing/step_test.h"
+#include "telemetry/latency.h"
+#include "telemetry/udp_sink.h"
 
-// Function prototype for sending angle data
-void sendAngleData(float angle, float target);
+// The OLED shares the I2C bus with the IMU and a full refresh takes tens of
+// milliseconds, so it is off unless explicitly enabled
+#define ENABLE_OLED 0
 
-// OLED_Display oled;
+// Loop rates (periods in microseconds)
+const uint32_t ATTITUDE_PERIOD_US = 5000;    // 200 Hz: IMU, estimator, balance PID, motors
+const uint32_t DRIVE_PERIOD_US = 20000;      // 50 Hz: encoders, velocity and steering loops
+const uint32_t TELEMETRY_PERIOD_US = 20000;  // 50 Hz: tilt/PID stream sampling (clients pick their own rate)
+const uint32_t STREAMS_PERIOD_US = 10000;    // 100 Hz: drain per-client WebSocket queues
+const uint32_t CONSOLE_PERIOD_US = 50000;    // 20 Hz: serial console
+const uint32_t DISPLAY_PERIOD_US = 500000;   // 2 Hz: OLED
+const uint32_t REPORT_PERIOD_US = 1000000;   // 1 Hz: scheduler overrun report
+const uint32_t METRICS_PERIOD_US = 1000000;  // 1 Hz: stream/command metrics to subscribers
+const uint32_t WIFI_PERIOD_US = 100000;      // 10 Hz: WiFi connection manager
+const uint32_t LOAD_PERIOD_US = 1000000;     // 1 Hz: loop rate and load for /metrics
+const uint32_t SHED_PERIOD_US = 250000;      // 4 Hz: deadline-miss window for load shedding
+const uint32_t STATUS_PERIOD_US = 250000;    // 4 Hz: status change detection for the dashboard
+const uint32_t LATENCY_PERIOD_US = 1000000;  // 1 Hz: command latency percentiles
+const uint32_t STEP_REPORT_PERIOD_US = 50000; // 20 Hz: step-test results and trace chunks
+const uint32_t BOOT_REPORT_PERIOD_US = 1000000; // 1 Hz: until the boot timeline is printed
 
-// Counter for periodic angle data sending
-static int angleSendCounter = 0;
+#if ENABLE_OLED
+OLED_Display oled;
+
+void updateOled()
+{
+  if (loadShedLevel() >= SHED_DISPLAY)
+    return;
+  oled.displaySensorData(lastGyro, lastAccel);
+}
+#endif
+
+// LittleFS mount, WiFi start and web server setup run on the protocol core
+// while setup() calibrates the IMU on the application core
+void networkInitTask(void *param)
+{
+  initWiFi();
+  vTaskDelete(NULL);
+}
 
 void setup()
 {
   Serial.begin(115200);
- 
-  // if (!oled.begin())
-  // {
-  //   Serial.println("OLED initialization failed");
-  // }
-  // else
-  // {
-  //   Serial.println("OLED initialized successfully");
-  //   oled.setBrightness(255);
-  //   oled.clearDisplay();
-  //   oled.displayText("Robot Initializing...", 0, 0, 1);
-  //   oled.updateDisplay();
-  // }
+  markBootPhase(BOOT_SETUP);
+
+#if ENABLE_OLED
+  if (!oled.begin())
+  {
+    Serial.println("OLED initialization failed");
+  }
+  else
+  {
+    Serial.println("OLED initialized successfully");
+    oled.setBrightness(255);
+    oled.clearDisplay();
+    oled.displayText("Robot Initializing...", 0, 0, 1);
+    oled.updateDisplay();
+  }
+#endif
 
   // Initialize the robot controller
+  initCommandQueue();
+  initCommands();
   initController();
+  initTuning();
+  markBootPhase(BOOT_CONTROLLER);
+
+  xTaskCreatePinnedToCore(networkInitTask, "netInit", 8192, NULL, 1, NULL, 0);
+
   initGyro();
+  markBootPhase(BOOT_IMU);
+  initEncoders();
+  initCapture();
+  initBlackbox();
+  initUdpSink();
   calibrateAll();
+  markBootPhase(BOOT_CALIBRATED);
 
+  // Motors stay off until balanceRobot() sees the estimator converge
   initBalance();
   setSpeed(60); // Set initial speed to 60%
 
-  initWiFi();
+  // Highest priority first
+  addTask("attitude", balanceRobot, ATTITUDE_PERIOD_US, 2000);
+  addTask("drive", updateDriveLoops, DRIVE_PERIOD_US, 500);
+  addTask("telemetry", sendBalanceTelemetry, TELEMETRY_PERIOD_US, 1000);
+  addTask("streams", pumpStreams, STREAMS_PERIOD_US, 2000);
+  addTask("console", handleKeyboardInputs, CONSOLE_PERIOD_US, 1000);
+#if ENABLE_OLED
+  addTask("display", updateOled, DISPLAY_PERIOD_US, 50000);
+#endif
+  addTask("report", reportSchedulerOverruns, REPORT_PERIOD_US, 2000);
+  addTask("metrics", sendStreamMetrics, METRICS_PERIOD_US, 1000);
+  addTask("wifi", updateWiFi, WIFI_PERIOD_US, 2000);
+  addTask("load", sampleMetrics, LOAD_PERIOD_US, 500);
+  addTask("shed", updateLoadShedding, SHED_PERIOD_US, 500);
+  addTask("status", sendStatusUpdates, STATUS_PERIOD_US, 1000);
+  addTask("latency", sendLatencyReport, LATENCY_PERIOD_US, 2000);
+  addTask("steptest", reportStepTest, STEP_REPORT_PERIOD_US, 2000);
+  addTask("boot", reportBootTimeline, BOOT_REPORT_PERIOD_US, 5000);
+  markBootPhase(BOOT_SCHEDULER);
 }
 
 void loop()
 {
-  handleKeyboardInputs();
-
-  // Balance the robot
-  balanceRobot();
-
-  // // Send angle data to WebSocket clients periodically (every 20 loops ~100ms)
-  // angleSendCounter++;
-  // if (angleSendCounter >= 10) {
-  //   sendAngleData();
-  //   angleSendCounter = 0;
-  // }
-
-
-
-  // Display gyro and accelerometer data on OLED using combined function
-  // oled.displaySensorData(gyro, accel);
-
-   // Small delay for stability
-  delay(5); // Reduced from 10ms for faster response
-}
\ No newline at end of file
+  runScheduler();
+}
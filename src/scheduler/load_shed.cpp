@@ -0,0 +1,52 @@
+#include "load_shed.h"
+#include "scheduler.h"
+
+// Evaluated once per window (the task period): shed one more level when a
+// window has this many misses, restore one after this many clean windows
+const uint32_t SHED_MISS_THRESHOLD = 2;
+const int SHED_RESTORE_WINDOWS = 8;
+
+const char *const SHED_LEVEL_NAMES[] = {"none", "telemetry", "console", "display"};
+
+static volatile ShedLevel shedLevel = SHED_NONE;
+static uint32_t lastMisses = 0;
+static int cleanWindows = 0;
+
+static void setShedLevel(ShedLevel level, uint32_t misses)
+{
+    Serial.printf("Load shedding: %s -> %s (%lu deadline misses)\n", SHED_LEVEL_NAMES[shedLevel],
+                  SHED_LEVEL_NAMES[level], (unsigned long)misses);
+    shedLevel = level;
+    cleanWindows = 0;
+}
+
+void updateLoadShedding()
+{
+    if (getTaskCount() == 0)
+        return;
+
+    // The first task is the attitude loop
+    uint32_t total = getTask(0).deadlineMisses;
+    uint32_t misses = total - lastMisses;
+    lastMisses = total;
+
+    if (misses >= SHED_MISS_THRESHOLD)
+    {
+        if (shedLevel < SHED_LEVEL_COUNT - 1)
+            setShedLevel((ShedLevel)(shedLevel + 1), misses);
+        cleanWindows = 0;
+    }
+    else if (misses == 0 && shedLevel > SHED_NONE && ++cleanWindows >= SHED_RESTORE_WINDOWS)
+    {
+        setShedLevel((ShedLevel)(shedLevel - 1), misses);
+    }
+    else if (misses > 0)
+    {
+        cleanWindows = 0;
+    }
+}
+
+ShedLevel loadShedLevel()
+{
+    return shedLevel;
+}
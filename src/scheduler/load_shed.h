@@ -0,0 +1,22 @@
+#ifndef LOAD_SHED_H
+#define LOAD_SHED_H
+
+#include <Arduino.h>
+
+// Optional work dropped, cumulatively, while the attitude loop misses deadlines
+enum ShedLevel
+{
+    SHED_NONE,
+    SHED_TELEMETRY, // Tilt/PID stream sampling at a quarter of its rate
+    SHED_CONSOLE,   // Console lines no longer mirrored to WebSocket clients
+    SHED_DISPLAY,   // OLED refresh skipped
+    SHED_LEVEL_COUNT
+};
+
+extern const char *const SHED_LEVEL_NAMES[];
+
+// Check the attitude task's deadline misses and step the level; call periodically
+void updateLoadShedding();
+ShedLevel loadShedLevel();
+
+#endif
@@ -0,0 +1,128 @@
+#include "scheduler.h"
+
+static ScheduledTask tasks[MAX_SCHEDULED_TASKS];
+static int taskCount = 0;
+static uint32_t reportedOverruns[MAX_SCHEDULED_TASKS];
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED; // Run statistics, read by getTaskStats()
+
+// Register a periodic task, returns its index or -1 if the table is full
+int addTask(const char *name, TaskFunction fn, uint32_t periodUs, uint32_t budgetUs)
+{
+    if (taskCount >= MAX_SCHEDULED_TASKS)
+    {
+        Serial.printf("Scheduler full, task %s not added\n", name);
+        return -1;
+    }
+
+    ScheduledTask &task = tasks[taskCount];
+    task.name = name;
+    task.fn = fn;
+    task.periodUs = periodUs;
+    task.budgetUs = budgetUs;
+    task.nextRunUs = micros();
+    task.lastExecUs = 0;
+    task.maxExecUs = 0;
+    task.runs = 0;
+    task.overruns = 0;
+    task.totalExecUs = 0;
+    task.maxLateUs = 0;
+    task.deadlineMisses = 0;
+    reportedOverruns[taskCount] = 0;
+    return taskCount++;
+}
+
+static void runTask(ScheduledTask &task, uint32_t now)
+{
+    uint32_t due = task.nextRunUs;
+
+    // Keep the phase when on time, skip missed periods when badly late
+    task.nextRunUs += task.periodUs;
+    if ((int32_t)(now - task.nextRunUs) >= 0)
+    {
+        task.nextRunUs = now + task.periodUs;
+    }
+
+    uint32_t start = micros();
+    task.fn();
+    uint32_t exec = micros() - start;
+    uint32_t late = start - due;
+
+    portENTER_CRITICAL(&statsMux);
+    task.lastExecUs = exec;
+    task.totalExecUs += exec;
+    if (exec > task.maxExecUs)
+        task.maxExecUs = exec;
+    if (exec > task.budgetUs)
+        task.overruns++;
+    task.runs++;
+
+    // Deadline: each run must be done before the next one is due
+    if (late > task.maxLateUs)
+        task.maxLateUs = late;
+    if (late + exec > task.periodUs)
+        task.deadlineMisses++;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+// Run at most one due task per call, highest priority first, so a slow
+// task can delay the fast loop by no more than its own execution time
+void runScheduler()
+{
+    uint32_t now = micros();
+    int32_t earliest = INT32_MAX;
+
+    for (int i = 0; i < taskCount; i++)
+    {
+        int32_t untilDue = (int32_t)(tasks[i].nextRunUs - now);
+        if (untilDue <= 0)
+        {
+            runTask(tasks[i], now);
+            return;
+        }
+        if (untilDue < earliest)
+            earliest = untilDue;
+    }
+
+    // Nothing due: give the CPU to other tasks (WiFi, AsyncTCP) if there is time
+    if (earliest > 1000)
+    {
+        vTaskDelay(1);
+    }
+}
+
+// Print tasks that went over budget since the last report
+void reportSchedulerOverruns()
+{
+    for (int i = 0; i < taskCount; i++)
+    {
+        ScheduledTask &task = tasks[i];
+        if (task.overruns != reportedOverruns[i])
+        {
+            Serial.printf("Task %s over budget %lu times (last %luus, max %luus, budget %luus)\n",
+                          task.name, (unsigned long)(task.overruns - reportedOverruns[i]),
+                          (unsigned long)task.lastExecUs, (unsigned long)task.maxExecUs, (unsigned long)task.budgetUs);
+            reportedOverruns[i] = task.overruns;
+        }
+    }
+}
+
+int getTaskCount()
+{
+    return taskCount;
+}
+
+const ScheduledTask &getTask(int index)
+{
+    return tasks[index];
+}
+
+// Copy of every task's statistics taken in one critical section, so another
+// task sees whole 64-bit totals and counters from the same run
+int getTaskStats(ScheduledTask *stats, int maxTasks)
+{
+    portENTER_CRITICAL(&statsMux);
+    int n = min(taskCount, maxTasks);
+    memcpy(stats, tasks, n * sizeof(ScheduledTask));
+    portEXIT_CRITICAL(&statsMux);
+    return n;
+}
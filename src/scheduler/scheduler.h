@@ -0,0 +1,39 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+// Cooperative multi-rate scheduler run from loop().
+// Tasks are checked in the order they were added, so add the fastest/most critical first.
+typedef void (*TaskFunction)();
+
+struct ScheduledTask
+{
+    const char *name;
+    TaskFunction fn;
+    uint32_t periodUs;
+    uint32_t budgetUs;   // Execution time allowed per run
+    uint32_t nextRunUs;
+    uint32_t lastExecUs;
+    uint32_t maxExecUs;
+    uint32_t runs;
+    uint32_t overruns;   // Runs that exceeded budgetUs
+    uint64_t totalExecUs; // For load accounting
+    uint32_t maxLateUs;   // Worst start delay after the due time
+    uint32_t deadlineMisses; // Runs that finished after the next period was due
+};
+
+const int MAX_SCHEDULED_TASKS = 16;
+
+int addTask(const char *name, TaskFunction fn, uint32_t periodUs, uint32_t budgetUs);
+void runScheduler(); // Call from loop()
+void reportSchedulerOverruns();
+
+// Loop task only
+int getTaskCount();
+const ScheduledTask &getTask(int index);
+
+// Snapshot for other tasks (the metrics render), returns the number copied
+int getTaskStats(ScheduledTask *stats, int maxTasks);
+
+#endif
@@ -1,23 +1,134 @@
 #include "balance.h"
 #include "control/input_controller.h"
 #include "wifi/wifi_manager.h"
+#include "control/command_queue.h"
+#include "encoder/encoder.h"
+#include "control/trajectory.h"
+#include "boot/boot_timeline.h"
+#include "telemetry/capture.h"
+#include "telemetry/blackbox.h"
+#include "scheduler/load_shed.h"
+#include "control/tuning.h"
+#include "step_test.h"
+#include "control/joystick.h"
+#include "telemetry/udp_sink.h"
 
 // PID controller for balancing
 PIDController balancePID = {5.0, 0.0, 0.0, 0.0, 0.0, 0, 0};
 
-// Counter for periodic angle data sending
-static int angleSendCounter = 0;
+// Drive/steering mixer
+SteeringConfig steeringConfig = {3.0, 90.0, 0.3, 0.2};
+
+// Velocity/position-hold outer loop, off until the encoders have been seen counting
+VelocityConfig velocityConfig = {false, 400.0, 0.01, 2.0};
+static float holdPosition = 0.0;
+
+// Latest controller state, shared between the fast and slow loops
+BalanceState balanceState = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, false, false, false};
+
+// Setpoint profiles: target angle (degrees), forward and yaw-rate commands (%)
+SetpointProfile targetAngleProfile;
+SetpointProfile forwardProfile;
+SetpointProfile yawRateProfile;
+static unsigned long lastProfileTime = 0;
+
+// Arming: the filtered angle must track the accelerometer angle for a while
+const float ESTIMATOR_CONVERGED_DEG = 1.0;
+const int ARM_SETTLE_TICKS = 50; // 250 ms at 200 Hz
+static int convergedTicks = 0;
+
+// Mirror a newly swapped-in tuning profile into the controller, all fields in the same tick
+static void syncTuning()
+{
+    if (!swapTuning())
+        return;
+
+    const TuningProfile &tuning = activeTuning();
+    balancePID.kp = tuning.kp;
+    balancePID.ki = tuning.ki;
+    balancePID.kd = tuning.kd;
+    balancePID.baseSpeed = (int)tuning.baseSpeed;
+}
 
 // Initialize balancing
 void initBalance()
 {
+    syncTuning();
     balancePID.lastTime = millis();
 
     // Initialize currentAngle to the initial accelerometer angle
-    AccelData initialAccel = readAccel(accelOffsets);
-    currentAngle = atan2(-initialAccel.x, initialAccel.z) * 180.0 / PI;
-    currentAngle = fmod(currentAngle + 360.0, 360.0);
-    lastAngleTime = millis();
+    resetAngle();
+
+    resetOdometry();
+    holdPosition = 0.0;
+
+    initProfile(targetAngleProfile, handleTargetAngle(0, 0).targetAngle, 2.0, 10.0);
+    initProfile(forwardProfile, 0.0, 100.0, 200.0);
+    initProfile(yawRateProfile, 0.0, 200.0, 400.0);
+    lastProfileTime = micros();
+}
+
+// Record this tick for the capture buffer and the fall recorder
+static void recordControlSample(float angle, float setpoint)
+{
+    ControlSample sample;
+    // Exact estimator input, so recordings can be replayed by tools/imu_replay
+    sample.timeUs = lastImuSample.timeUs;
+    memcpy(sample.gyro, lastImuSample.gyro, sizeof(sample.gyro));
+    memcpy(sample.accel, lastImuSample.accel, sizeof(sample.accel));
+    sample.angle = angle;
+    sample.setpoint = setpoint;
+    sample.pTerm = balancePID.pTerm;
+    sample.iTerm = balancePID.iTerm;
+    sample.dTerm = balancePID.dTerm;
+    int left, right;
+    getMotorDuties(left, right);
+    sample.leftDuty = left;
+    sample.rightDuty = right;
+    sample.flags = (balanceState.armed ? SAMPLE_ARMED : 0) | (balanceState.fallen ? SAMPLE_FALLEN : 0) |
+                   (imuHealth.consecutiveFailures > 0 ? SAMPLE_IMU_STALE : 0);
+    sample.reserved = 0;
+    captureSample(sample);
+    blackboxSample(sample);
+    udpSinkSample(sample);
+}
+
+// Stop driving the motors until the estimator has converged again
+void disarmBalance()
+{
+    balanceState.armed = false;
+    convergedTicks = 0;
+    abortStepTest("disarmed");
+    stopMovement();
+}
+
+// The IMU came back, or was recalibrated, and the operator has asked to arm again
+void clearFaultLatch()
+{
+    balanceState.faultLatched = false;
+    convergedTicks = 0;
+}
+
+// Count consecutive ticks where the complementary filter agrees with the accelerometer
+static void checkArming(float angle)
+{
+    if (abs(angle - lastAccelAngle) < ESTIMATOR_CONVERGED_DEG)
+        convergedTicks++;
+    else
+        convergedTicks = 0;
+
+    if (convergedTicks >= ARM_SETTLE_TICKS && !imuHealth.faulted && !balanceState.faultLatched && !gyroCalibrating())
+    {
+        // Start from a clean controller state
+        resetProfile(targetAngleProfile, handleTargetAngle(0, 0).targetAngle);
+        lastProfileTime = micros();
+        balancePID.integral = 0;
+        balancePID.previousError = angle - targetAngleProfile.value;
+        balancePID.lastTime = millis();
+        balanceState.armed = true;
+        markBootPhase(BOOT_ARMED);
+        SERIAL_PRINTLN("Estimator converged, balancing armed");
+    }
 }
 
 // Update PID controller
@@ -47,39 +158,96 @@ float updatePID(PIDController &pid, float error, float deadBand)
     float derivative = (error - pid.previousError) / dt;
     // Low-pass filter the derivative to reduce noise amplification
     static float filteredDerivative = 0.0;
-    filteredDerivative = 0.9 * filteredDerivative + 0.1 * derivative;
+    float derivativeFilter = activeTuning().derivativeFilter;
+    filteredDerivative = derivativeFilter * filteredDerivative + (1 - derivativeFilter) * derivative;
     derivative = filteredDerivative;
     float dTerm = pid.kd * derivative;
     pid.previousError = error;
 
     // Total output
     float output = pTerm + iTerm + dTerm;
+    pid.pTerm = pTerm;
+    pid.iTerm = iTerm;
+    pid.dTerm = dTerm;
 
     return output;
 }
 
-// Balance the robot
+// Outer loop: turn the forward command (or position hold when idle) into a lean offset
+float updateVelocityLoop(float forward)
+{
+    if (!velocityConfig.enabled)
+    {
+        return forward / 100.0 * steeringConfig.maxLean;
+    }
+
+    const WheelOdometry &odo = getOdometry();
+    float velocitySetpoint;
+    if (forward != 0)
+    {
+        velocitySetpoint = forward / 100.0 * velocityConfig.maxSpeed;
+        holdPosition = odo.distance; // Hold wherever we stop driving
+    }
+    else
+    {
+        velocitySetpoint = velocityConfig.kpPosition * (holdPosition - odo.distance);
+        velocitySetpoint = constrain(velocitySetpoint, -velocityConfig.maxSpeed, velocityConfig.maxSpeed);
+    }
+
+    float lean = velocityConfig.kpVelocity * (velocitySetpoint - odo.velocity);
+    return constrain(lean, -steeringConfig.maxLean, steeringConfig.maxLean);
+}
+
+// Balance the robot (fast attitude loop)
 void balanceRobot()
 {
+    // Apply commands posted by serial/HTTP/WebSocket handlers since the last tick
+    applyPendingCommands();
+    syncTuning();
+
     ControlParams params = handleTargetAngle(0, 0);
 
 
     float angle = calculateAngle();
-    
-    // Send angle data to WebSocket clients periodically (every 20 loops ~100ms)
-    angleSendCounter++;
-    if (angleSendCounter >= 20) {
-        sendAngleData(angle, params.targetAngle);
-        angleSendCounter = 0;
+    balanceState.angle = angle;
+    if (sampleGyroCalibration())
+        SERIAL_PRINTLN("Recalibrated gyro and accelerometer.");
+
+    // No fresh IMU data for too long: stop and stay disarmed until an arm or
+    // calibrate command, the robot may be being handled after a bus fault
+    if (imuHealth.faulted && !balanceState.faultLatched)
+    {
+        balanceState.faultLatched = true;
+        disarmBalance();
+        SERIAL_PRINTLN("IMU fault, motors disarmed until the next arm command");
+    }
+
+    if (!balanceState.armed)
+    {
+        checkArming(angle);
+        if (!balanceState.armed)
+        {
+            stopMovement();
+            recordControlSample(angle, balanceState.setpoint);
+            return;
+        }
     }
-    
 
     // angle = round(angle); // Round to nearest whole degree to reduce noise
     // Serial.printf("Kp: %.3f, Ki: %.3f, Kd: %.3f\n", balancePID.kp, balancePID.ki, balancePID.kd);
 
     // Serial.printf("Accel X: %.2f, Y: %.2f, Z: %.2f\n", accel.x, accel.y, accel.z);
 
-    float error = angle - params.targetAngle; // Positive when tilted forward
+    // Ramp target-angle changes instead of stepping the PID
+    unsigned long now = micros();
+    float profileDt = (now - lastProfileTime) / 1000000.0;
+    lastProfileTime = now;
+    float profiledTarget = updateProfile(targetAngleProfile, params.targetAngle, profileDt);
+
+    // Forward velocity setpoint: lean offset from the slower drive loop
+    float setpoint = profiledTarget + balanceState.leanOffset + stepTestOffset();
+
+    float error = angle - setpoint; // Positive when tilted forward
     // Serial.printf("Angle: %.2f, Error: %.2f\n", angle, error);
     // Serial.printf("Angle:%.2f\n, Target:%.2f\n, Error:%.2f\n", angle, targetAngle, error);
     // Serial.print(">Angle:");
@@ -100,7 +268,8 @@ void balanceRobot()
 
     // Low-pass filter the PID output to reduce jitter
     static float filteredPidOutput = 0.0;
-    filteredPidOutput = 0.9 * filteredPidOutput + 0.1 * pidOutput;
+    float outputFilter = activeTuning().outputFilter;
+    filteredPidOutput = outputFilter * filteredPidOutput + (1 - outputFilter) * pidOutput;
     pidOutput = filteredPidOutput;
 
     // Constrain PID output to prevent excessive speeds
@@ -108,8 +277,14 @@ void balanceRobot()
 
     // Convert PID output to motor speeds
     // Base speed provides steady-state balancing torque
-    int leftSpeed = balancePID.baseSpeed + pidOutput;
-    int rightSpeed = balancePID.baseSpeed + pidOutput;
+    float balanceOutput = constrain(balancePID.baseSpeed + pidOutput + stepTestDisturbance(), -100, 100);
+
+    // Balance has priority: steering only gets the duty left over
+    float headroom = 100 - abs(balanceOutput);
+    float steer = constrain(balanceState.steer, -headroom, headroom);
+
+    int leftSpeed = balanceOutput - steer;
+    int rightSpeed = balanceOutput + steer;
 
     // Stop motors if angle is too extreme (fallen over)
     if (angle > 140.0)
@@ -130,63 +305,60 @@ void balanceRobot()
     }
     // Set motor speeds
     setMotorSpeeds(leftSpeed, rightSpeed);
+    joystickActuated();
+
+    balanceState.angle = angle;
+    balanceState.commandedTarget = params.targetAngle;
+    balanceState.setpoint = setpoint;
+    balanceState.output = balanceOutput;
+    balanceState.fallen = angle > 140.0 || angle < 40.0;
+
+    if (balanceState.fallen)
+        abortStepTest("fell over");
+    stepTestSample(angle, setpoint);
+    recordControlSample(angle, setpoint);
 }
 
-void adjustPIDGainsFromSerial(char qawsedrf)
+// Velocity and steering loops, run at a divided rate of balanceRobot()
+void updateDriveLoops()
 {
-    Serial.println("PID gains: Kp=" + String(balancePID.kp, 3) + ", Ki=" + String(balancePID.ki, 3) + ", Kd=" + String(balancePID.kd, 3) + ", BaseSpeed=" + String(balancePID.baseSpeed));
+    static unsigned long lastDriveTime = micros();
+    unsigned long now = micros();
+    float dt = (now - lastDriveTime) / 1000000.0;
+    lastDriveTime = now;
 
-    float kp = balancePID.kp, ki = balancePID.ki, kd = balancePID.kd, baseSpeed = balancePID.baseSpeed;
-    if (qawsedrf == 'w')
-    {
-        kp += 0.1; // Increase Kp
-    }
-    else if (qawsedrf == 's')
-    {
-        kp -= 0.1; // Decrease Kp
-        if (kp < 0)
-            kp = 0; // Prevent negative Kp
-    }
-    else if (qawsedrf == 'e')
-    {
-        ki += 0.001; // Increase Ki
-    }
-    else if (qawsedrf == 'd')
-    {
-        ki -= 0.001; // Decrease Ki
-        if (ki < 0)
-            ki = 0; // Prevent negative Ki
-    }
-    else if (qawsedrf == 'r')
-    {
-        kd += 0.001; // Increase Kd
-    }
-    else if (qawsedrf == 'f')
-    {
-        kd -= 0.001; // Decrease Kd
-        if (kd < 0)
-            kd = 0; // Prevent negative Kd
-    }
-    else if (qawsedrf == 'q')
-    {
-        baseSpeed += 5; // Increase base speed
-    }
-    else if (qawsedrf == 'a')
-    {
-        baseSpeed -= 5; // Decrease base speed
-        if (baseSpeed < 0)
-            baseSpeed = 0; // Prevent negative speed
-    }
-    else
+    applyJoystick();
+    float forward = updateProfile(forwardProfile, driveCommand.forward, dt);
+    float yawCommand = updateProfile(yawRateProfile, driveCommand.yawRate, dt);
+
+    int leftDuty, rightDuty;
+    getMotorDuties(leftDuty, rightDuty);
+    updateEncoders(leftDuty, rightDuty);
+    // Enabled once; clearing velocityConfig.enabled afterwards is not undone
+    static bool encodersSeen = false;
+    if (!encodersSeen && encodersDetected())
     {
-        Serial.println("Invalid input for PID gain adjustment. Use 'w', 's', 'e', 'd', 'r', or 'f'.");
-        return;
+        encodersSeen = true;
+        velocityConfig.enabled = true;
+        holdPosition = getOdometry().distance;
+        SERIAL_PRINTLN("Wheel encoders detected, velocity loop enabled");
     }
+    balanceState.leanOffset = updateVelocityLoop(forward);
 
-    balancePID.kp = kp;
-    balancePID.ki = ki;
-    balancePID.kd = kd;
-    balancePID.baseSpeed = baseSpeed;
+    // Yaw-rate loop; X axis points down so a left turn reads as negative gyro X
+    float yawSetpoint = yawCommand / 100.0 * steeringConfig.maxYawRate;
+    float yawRate = -lastGyro.x;
+    balanceState.steer = steeringConfig.yawFeedForward * yawSetpoint + steeringConfig.yawKp * (yawSetpoint - yawRate);
+}
 
-    Serial.println("Adjusted PID gains: Kp=" + String(balancePID.kp, 3) + ", Ki=" + String(balancePID.ki, 3) + ", Kd=" + String(balancePID.kd, 3) + ", BaseSpeed=" + String(balancePID.baseSpeed));
-}
\ No newline at end of file
+// Send angle data and PID terms to subscribed WebSocket clients
+void sendBalanceTelemetry()
+{
+    // Shedding load: only every 4th sample
+    static uint8_t shedSkip = 0;
+    if (loadShedLevel() >= SHED_TELEMETRY && (++shedSkip & 3) != 0)
+        return;
+
+    sendAngleData(balanceState.angle, balanceState.setpoint, balanceState.commandedTarget, lastImuSample.timeUs);
+    sendPIDTerms(balancePID.pTerm, balancePID.iTerm, balancePID.dTerm, balanceState.output);
+}
@@ -4,6 +4,7 @@
 #include <Arduino.h>
 #include "gyro/gyro.h"
 #include "wifi/wifi_manager.h"
+#include "control/trajectory.h"
 
 // PID controller structure
 struct PIDController
@@ -15,6 +16,41 @@ struct PIDController
     float previousError;
     unsigned long lastTime;
     int baseSpeed;
+    float pTerm; // Terms from the last update, for telemetry
+    float iTerm;
+    float dTerm;
+};
+
+// Drive/steering mixer configuration
+struct SteeringConfig
+{
+    float maxLean;        // Target-angle offset (degrees) at full forward command
+    float maxYawRate;     // Yaw rate (deg/s) at full turn command
+    float yawFeedForward; // Motor % per deg/s of commanded yaw rate
+    float yawKp;          // Motor % per deg/s of yaw-rate error
+};
+
+// Outer velocity/position-hold loop on the wheel encoders, output is a target-angle offset
+struct VelocityConfig
+{
+    bool enabled;     // Falls back to an open-loop lean when false; set once encoders are detected
+    float maxSpeed;   // Wheel speed (mm/s) at full forward command
+    float kpVelocity; // Degrees of lean per mm/s of velocity error
+    float kpPosition; // mm/s of velocity setpoint per mm of position error
+};
+
+// Latest controller state, written by the control loops
+struct BalanceState
+{
+    float angle;           // Estimated tilt (degrees)
+    float commandedTarget; // Requested target angle before profiling (degrees)
+    float setpoint;        // Profiled target angle plus lean offset (degrees)
+    float leanOffset;      // Output of the velocity loop (degrees)
+    float steer;           // Output of the yaw-rate loop before saturation (motor %)
+    float output;          // Balance motor command (motor %)
+    bool armed;            // Motors driven only once the estimator has converged
+    bool fallen;           // Tilt outside the recoverable range, motors cut
+    bool faultLatched;     // Disarmed by an IMU fault, stays so until an arm or calibrate command
 };
 
 // Global variables
@@ -25,12 +61,22 @@ extern AccelOffsets accelOffsets;
 void initBalance();
 float updatePID(PIDController &pid, float error, float deadBand);
 void balanceRobot();
-void adjustPIDGainsFromSerial(char input);
+void disarmBalance();
+void clearFaultLatch();
+void updateDriveLoops();
+float updateVelocityLoop(float forward);
+void sendBalanceTelemetry();
 
 // Global PID controller access
 extern PIDController balancePID;
+extern SteeringConfig steeringConfig;
+extern VelocityConfig velocityConfig;
+extern BalanceState balanceState;
+extern SetpointProfile targetAngleProfile;
+extern SetpointProfile forwardProfile;
+extern SetpointProfile yawRateProfile;
 
 // Function to send angle data via WebSocket
-extern void sendAngleData(float angle, float target);
+extern void sendAngleData(float angle, float target, float commanded, uint32_t sampleUs);
 
 #endif
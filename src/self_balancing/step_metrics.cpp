@@ -0,0 +1,77 @@
+#include "step_metrics.h"
+
+const float STEP_SETTLE_FRACTION = 0.05; // Settle band, fraction of the step
+const float STEP_SETTLE_MIN_DEG = 0.2;   // Never tighter than the estimator noise
+
+float stepBaseline(const StepPoint *points, int stepIndex)
+{
+    float sum = 0;
+    for (int i = 0; i < stepIndex; i++)
+        sum += points[i].angle;
+    return stepIndex > 0 ? sum / stepIndex : 0;
+}
+
+void computeStepMetrics(const StepPoint *points, int count, int stepIndex, StepTestKind kind, float amplitude,
+                        StepMetrics &m)
+{
+    float baseline = stepBaseline(points, stepIndex);
+    float final = kind == STEP_TARGET ? baseline + amplitude : baseline;
+    float band = max(STEP_SETTLE_FRACTION * abs(amplitude), STEP_SETTLE_MIN_DEG);
+    if (kind == STEP_IMPULSE)
+        band = STEP_SETTLE_MIN_DEG;
+
+    m.riseTime = -1;
+    m.overshoot = 0;
+    m.settlingTime = 0;
+    m.iae = 0;
+
+    int rise10 = -1;
+    int rise90 = -1;
+    float peak = 0; // Step: normalized response; impulse: deviation in degrees
+    int lastOutside = -1;
+    for (int i = stepIndex; i < count; i++)
+    {
+        const StepPoint &p = points[i];
+        if (i > stepIndex)
+            m.iae += abs(p.setpoint - p.angle) * (p.timeUs - points[i - 1].timeUs) / 1000000.0;
+
+        if (abs(p.angle - final) > band)
+            lastOutside = i;
+
+        if (kind == STEP_TARGET)
+        {
+            float response = (p.angle - baseline) / amplitude;
+            if (rise10 < 0 && response >= 0.1)
+                rise10 = i;
+            if (rise90 < 0 && response >= 0.9)
+                rise90 = i;
+            peak = max(peak, response);
+        }
+        else
+        {
+            peak = max(peak, (float)abs(p.angle - baseline));
+        }
+    }
+
+    if (kind == STEP_TARGET)
+    {
+        if (rise10 >= 0 && rise90 >= 0)
+            m.riseTime = (points[rise90].timeUs - points[rise10].timeUs) / 1000000.0;
+        m.overshoot = max(0.0f, (peak - 1) * 100);
+    }
+    else
+    {
+        m.overshoot = peak;
+    }
+
+    if (lastOutside == count - 1)
+        m.settlingTime = -1;
+    else if (lastOutside >= 0)
+        m.settlingTime = (points[lastOutside + 1].timeUs - points[stepIndex].timeUs) / 1000000.0;
+
+    int tail = stepIndex + (count - stepIndex) * 4 / 5;
+    float sum = 0;
+    for (int i = tail; i < count; i++)
+        sum += points[i].setpoint - points[i].angle;
+    m.steadyStateError = count > tail ? sum / (count - tail) : 0;
+}
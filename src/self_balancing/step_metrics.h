@@ -0,0 +1,23 @@
+#ifndef STEP_METRICS_H
+#define STEP_METRICS_H
+
+#include "step_test.h"
+
+// Step-response metrics over a recorded run, kept apart from the recorder so
+// they can be checked on the host against synthetic responses
+
+struct StepPoint
+{
+    uint32_t timeUs;
+    float angle;
+    float setpoint;
+};
+
+// Mean angle of the samples before the step
+float stepBaseline(const StepPoint *points, int stepIndex);
+
+// points[0..stepIndex) is the baseline, points[stepIndex..count) the response
+void computeStepMetrics(const StepPoint *points, int count, int stepIndex, StepTestKind kind, float amplitude,
+                        StepMetrics &m);
+
+#endif
@@ -0,0 +1,212 @@
+#include "step_test.h"
+#include "step_metrics.h"
+#include "balance.h"
+#include "control/tuning.h"
+#include "wifi/wifi_manager.h"
+#include "wifi/json_format.h"
+
+const int STEP_PRE_SAMPLES = 50;       // Baseline recorded before the step (250 ms at 200 Hz)
+const int STEP_RUN_SAMPLES = 1000;     // 5 s at 200 Hz
+const int STEP_MAX_SAMPLES = STEP_PRE_SAMPLES + STEP_RUN_SAMPLES;
+const int STEP_IMPULSE_TICKS = 10;     // 50 ms at 200 Hz
+const float STEP_MAX_TARGET_DEG = 10.0;
+const float STEP_MIN_TARGET_DEG = 0.5;  // Smaller steps are lost in the estimator noise, and 0 divides by zero
+const int STEP_TRACE_DECIMATION = 2;
+const int STEP_TRACE_POINTS = 32;       // Trace points per WebSocket message
+
+const char *const STEP_TEST_KIND_NAMES[] = {"step", "impulse", "abort", NULL};
+
+enum StepTestState
+{
+    STEP_IDLE,
+    STEP_BASELINE, // Recording the pre-step samples
+    STEP_RUNNING,  // Step applied
+    STEP_DONE,     // Frozen, metrics not sent yet
+    STEP_SENDING   // Trace being sent
+};
+
+// Preallocated so a run never touches the heap from the control loop
+static StepPoint stepBuffer[STEP_MAX_SAMPLES];
+static int stepCount = 0;
+static int stepIndex = 0; // First sample after the step
+static int stepSent = 0;
+static StepTestState stepState = STEP_IDLE;
+static StepTestKind stepKind = STEP_TARGET;
+static float stepAmplitude = 0;
+static uint32_t stepDurationUs = 0;
+static uint32_t stepRun = 0;
+static const char *stepError = NULL; // Reported by the next reportStepTest()
+static uint32_t stepErrorRun = 0;    // Run the error belongs to, 0 for a rejected start
+
+static char stepReply[1024];
+
+void startStepTest(StepTestKind kind, float amplitude, float durationS)
+{
+    if (kind == STEP_ABORT)
+    {
+        abortStepTest("stopped");
+        return;
+    }
+    const char *rejected = NULL;
+    if (stepState != STEP_IDLE)
+        rejected = "a run is already in progress";
+    else if (!balanceState.armed)
+        rejected = "not balancing";
+    else if (kind == STEP_TARGET && abs(amplitude) > STEP_MAX_TARGET_DEG)
+        rejected = "step amplitude too large";
+    else if (kind == STEP_TARGET && abs(amplitude) < STEP_MIN_TARGET_DEG)
+        rejected = "step amplitude too small";
+    if (rejected != NULL)
+    {
+        stepError = rejected;
+        stepErrorRun = 0;
+        return;
+    }
+
+    stepKind = kind;
+    stepAmplitude = amplitude;
+    stepDurationUs = durationS * 1000000;
+    stepCount = 0;
+    stepIndex = 0;
+    stepSent = 0;
+    stepRun++;
+    stepState = STEP_BASELINE;
+    SERIAL_PRINTLN("Step test " + String(stepRun) + ": " + STEP_TEST_KIND_NAMES[kind] + " " + String(amplitude, 2));
+}
+
+void abortStepTest(const char *reason)
+{
+    if (stepState != STEP_BASELINE && stepState != STEP_RUNNING)
+        return;
+    stepState = STEP_IDLE;
+    stepError = reason;
+    stepErrorRun = stepRun;
+}
+
+bool stepTestActive()
+{
+    return stepState == STEP_BASELINE || stepState == STEP_RUNNING;
+}
+
+float stepTestOffset()
+{
+    return stepState == STEP_RUNNING && stepKind == STEP_TARGET ? stepAmplitude : 0;
+}
+
+float stepTestDisturbance()
+{
+    if (stepState != STEP_RUNNING || stepKind != STEP_IMPULSE)
+        return 0;
+    return stepCount - stepIndex < STEP_IMPULSE_TICKS ? stepAmplitude : 0;
+}
+
+void stepTestSample(float angle, float setpoint)
+{
+    if (!stepTestActive())
+        return;
+
+    StepPoint &point = stepBuffer[stepCount++];
+    point.timeUs = micros();
+    point.angle = angle;
+    point.setpoint = setpoint;
+
+    if (stepState == STEP_BASELINE)
+    {
+        // The step is applied from the next tick on
+        if (stepCount == STEP_PRE_SAMPLES)
+        {
+            stepIndex = stepCount;
+            stepState = STEP_RUNNING;
+        }
+        return;
+    }
+
+    uint32_t elapsed = point.timeUs - stepBuffer[stepIndex].timeUs;
+    if (stepCount == STEP_MAX_SAMPLES || elapsed >= stepDurationUs)
+        stepState = STEP_DONE;
+}
+
+// JSON null for metrics that do not apply
+static void appendMetric(size_t &len, const char *name, float value)
+{
+    if (value < 0)
+        appendJson(stepReply, sizeof(stepReply), len, ",\"%s\":null", name);
+    else
+        appendJson(stepReply, sizeof(stepReply), len, ",\"%s\":%.4f", name, value);
+}
+
+static void sendStepResult()
+{
+    StepMetrics m;
+    computeStepMetrics(stepBuffer, stepCount, stepIndex, stepKind, stepAmplitude, m);
+    TuningProfile tuning = latestTuning();
+
+    size_t len = 0;
+    appendJson(stepReply, sizeof(stepReply), len,
+               "{\"type\":\"step-result\",\"run\":%lu,\"kind\":\"%s\",\"amplitude\":%.2f,\"samples\":%d,\"profile\":",
+               (unsigned long)stepRun, STEP_TEST_KIND_NAMES[stepKind], stepAmplitude, stepCount - stepIndex);
+    appendJsonString(stepReply, sizeof(stepReply), len, tuningProfileName());
+    appendJson(stepReply, sizeof(stepReply), len, ",\"kp\":%.3f,\"ki\":%.3f,\"kd\":%.3f", tuning.kp, tuning.ki, tuning.kd);
+    appendMetric(len, "riseTime", m.riseTime);
+    appendMetric(len, stepKind == STEP_TARGET ? "overshoot" : "peak", m.overshoot);
+    appendMetric(len, "settlingTime", m.settlingTime);
+    appendJson(stepReply, sizeof(stepReply), len, ",\"steadyStateError\":%.4f,\"iae\":%.4f}", m.steadyStateError, m.iae);
+    broadcastText(stepReply, len);
+
+    SERIAL_PRINTLN("Step test " + String(stepRun) + ": rise " + String(m.riseTime, 3) + " s, overshoot " +
+                   String(m.overshoot, 1) + ", settling " + String(m.settlingTime, 3) + " s, sse " +
+                   String(m.steadyStateError, 3) + ", IAE " + String(m.iae, 3));
+}
+
+// One trace message: times (ms from the step) and angle/setpoint relative to the baseline
+static void sendStepTraceChunk()
+{
+    float baseline = stepBaseline(stepBuffer, stepIndex);
+    int end = min(stepSent + STEP_TRACE_POINTS * STEP_TRACE_DECIMATION, stepCount);
+
+    size_t len = 0;
+    appendJson(stepReply, sizeof(stepReply), len, "{\"type\":\"step-trace\",\"run\":%lu,\"last\":%s,\"t\":[",
+               (unsigned long)stepRun, end == stepCount ? "true" : "false");
+    for (int i = stepSent; i < end; i += STEP_TRACE_DECIMATION)
+        appendJson(stepReply, sizeof(stepReply), len, "%s%ld", i > stepSent ? "," : "",
+                   (long)(stepBuffer[i].timeUs - stepBuffer[stepIndex].timeUs) / 1000);
+    appendJson(stepReply, sizeof(stepReply), len, "],\"angle\":[");
+    for (int i = stepSent; i < end; i += STEP_TRACE_DECIMATION)
+        appendJson(stepReply, sizeof(stepReply), len, "%s%.2f", i > stepSent ? "," : "", stepBuffer[i].angle - baseline);
+    appendJson(stepReply, sizeof(stepReply), len, "],\"setpoint\":[");
+    for (int i = stepSent; i < end; i += STEP_TRACE_DECIMATION)
+        appendJson(stepReply, sizeof(stepReply), len, "%s%.2f", i > stepSent ? "," : "", stepBuffer[i].setpoint - baseline);
+    appendJson(stepReply, sizeof(stepReply), len, "]}");
+    broadcastText(stepReply, len);
+
+    stepSent = end;
+}
+
+void reportStepTest()
+{
+    if (stepError != NULL)
+    {
+        // Rejected starts never got a run number
+        size_t len = 0;
+        appendJson(stepReply, sizeof(stepReply), len, "{\"type\":\"step-result\"");
+        if (stepErrorRun != 0)
+            appendJson(stepReply, sizeof(stepReply), len, ",\"run\":%lu", (unsigned long)stepErrorRun);
+        appendJson(stepReply, sizeof(stepReply), len, ",\"error\":\"%s\"}", stepError);
+        broadcastText(stepReply, len);
+        SERIAL_PRINTLN(String(stepErrorRun != 0 ? "Step test aborted: " : "Step test rejected: ") + stepError);
+        stepError = NULL;
+    }
+
+    if (stepState == STEP_DONE)
+    {
+        sendStepResult();
+        stepState = STEP_SENDING;
+    }
+    else if (stepState == STEP_SENDING)
+    {
+        // Spread over several calls to stay within the task budget and the client queues
+        sendStepTraceChunk();
+        if (stepSent >= stepCount)
+            stepState = STEP_IDLE;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef STEP_TEST_H
+#define STEP_TEST_H
+
+#include <Arduino.h>
+
+// Step-response test: a target-angle step or a short motor impulse is applied
+// while balancing, the response is recorded at the full loop rate and the
+// metrics plus a decimated trace are sent to the dashboard.
+
+enum StepTestKind
+{
+    STEP_TARGET,  // amplitude in degrees added to the setpoint for the whole run
+    STEP_IMPULSE, // amplitude in motor % added to the output for STEP_IMPULSE_TICKS
+    STEP_ABORT
+};
+
+extern const char *const STEP_TEST_KIND_NAMES[];
+
+struct StepMetrics
+{
+    float riseTime;         // 10% to 90% of the step (s), -1 if not reached or impulse
+    float overshoot;        // Step: % past the final value; impulse: peak deviation (degrees)
+    float settlingTime;     // Last exit from the settle band after the step (s), -1 if never settled
+    float steadyStateError; // Mean setpoint - angle over the last 20% of the run (degrees)
+    float iae;              // Integral of |setpoint - angle| (degree seconds)
+};
+
+// Control loop only
+void startStepTest(StepTestKind kind, float amplitude, float durationS);
+void abortStepTest(const char *reason);
+float stepTestOffset();      // Degrees added to the setpoint
+float stepTestDisturbance(); // Motor % added to the balance output
+void stepTestSample(float angle, float setpoint); // Every armed tick
+bool stepTestActive();
+
+// Scheduler task: computes the metrics once a run completes and sends them with the trace
+void reportStepTest();
+
+#endif
@@ -0,0 +1,209 @@
+#include "blackbox.h"
+#include <LittleFS.h>
+#include "wifi/json_format.h"
+
+const char *const BLACKBOX_DIR = "/blackbox";
+
+// 3 s at 200 Hz, of which the last 0.5 s follow the fall
+const uint32_t BLACKBOX_SAMPLES = 600;
+const uint32_t BLACKBOX_POST_SAMPLES = 100;
+
+enum BlackboxState
+{
+    BLACKBOX_RECORDING,
+    BLACKBOX_POST_TRIGGER, // Fall seen, recording the aftermath
+    BLACKBOX_FROZEN        // Ring owned by the writer task until the file is saved
+};
+
+static ControlSample blackboxRing[BLACKBOX_SAMPLES];
+static uint32_t blackboxHead = 0;
+static uint32_t blackboxCount = 0;
+static uint32_t blackboxPostRemaining = 0;
+static uint32_t blackboxTriggerMs = 0;
+static bool lastSampleFallen = false;
+static volatile BlackboxState blackboxState = BLACKBOX_RECORDING;
+
+static TaskHandle_t blackboxTask = NULL;
+
+// Count the incidents in BLACKBOX_DIR and find the lowest and highest
+// incident numbers, however many files there are
+static int scanBlackboxFiles(uint32_t &oldest, uint32_t &newest)
+{
+    int n = 0;
+    oldest = UINT32_MAX;
+    newest = 0;
+    File dir = LittleFS.open(BLACKBOX_DIR);
+    if (!dir || !dir.isDirectory())
+        return 0;
+    File file = dir.openNextFile();
+    while (file)
+    {
+        const char *name = file.name();
+        if (isBlackboxFileName(name))
+        {
+            uint32_t sequence = strtoul(name + 5, NULL, 10);
+            oldest = min(oldest, sequence);
+            newest = max(newest, sequence);
+            n++;
+        }
+        file.close();
+        file = dir.openNextFile();
+    }
+    dir.close();
+    return n;
+}
+
+// Remove the oldest incidents so that at most keep files remain
+static void pruneBlackboxFiles(int keep)
+{
+    uint32_t oldest, newest;
+    while (scanBlackboxFiles(oldest, newest) > keep)
+    {
+        char path[32];
+        snprintf(path, sizeof(path), "%s/fall-%04lu.bin", BLACKBOX_DIR, (unsigned long)oldest);
+        if (!LittleFS.remove(path))
+            break; // Name not in the canonical form, leave it rather than loop
+    }
+}
+
+static uint32_t nextBlackboxSequence()
+{
+    uint32_t oldest, newest;
+    return scanBlackboxFiles(oldest, newest) > 0 ? newest + 1 : 1;
+}
+
+static void writeBlackboxFile()
+{
+    LittleFS.mkdir(BLACKBOX_DIR);
+    pruneBlackboxFiles(BLACKBOX_KEEP_FILES - 1);
+
+    BlackboxHeader header;
+    header.magic = BLACKBOX_MAGIC;
+    header.version = 1;
+    header.sampleSize = sizeof(ControlSample);
+    header.count = blackboxCount;
+    // The fall sample is the last one before the post-trigger samples
+    header.triggerIndex = blackboxCount - 1 - BLACKBOX_POST_SAMPLES;
+    header.sequence = nextBlackboxSequence();
+    header.uptimeMs = blackboxTriggerMs;
+
+    char path[32];
+    snprintf(path, sizeof(path), "%s/fall-%04lu.bin", BLACKBOX_DIR, (unsigned long)header.sequence);
+    File file = LittleFS.open(path, "w");
+    if (!file)
+    {
+        Serial.printf("Black box: cannot create %s\n", path);
+        return;
+    }
+
+    // Oldest first: the ring is written in at most two contiguous pieces
+    uint32_t start = blackboxCount < BLACKBOX_SAMPLES ? 0 : blackboxHead;
+    uint32_t first = min(blackboxCount, BLACKBOX_SAMPLES - start);
+    bool ok = file.write((const uint8_t *)&header, sizeof(header)) == sizeof(header);
+    ok = ok && file.write((const uint8_t *)&blackboxRing[start], first * sizeof(ControlSample)) == first * sizeof(ControlSample);
+    uint32_t second = blackboxCount - first;
+    ok = ok && file.write((const uint8_t *)blackboxRing, second * sizeof(ControlSample)) == second * sizeof(ControlSample);
+    file.close();
+
+    // Serial only: the web console buffer belongs to the loop task
+    if (ok)
+    {
+        Serial.printf("Black box: saved %s\n", path);
+    }
+    else
+    {
+        LittleFS.remove(path);
+        Serial.println("Black box: write failed, filesystem full?");
+    }
+}
+
+// Low-priority writer, woken by the control loop once the ring is frozen.
+// Running on core 0 keeps the file system calls out of the loop task, but
+// flash writes disable the cache on both cores: the control loop stalls for
+// each erase and program while the ~24 KB file is saved. By then the robot
+// has been down for BLACKBOX_POST_SAMPLES ticks, with the motors stopped.
+static void blackboxWriterTask(void *param)
+{
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (blackboxState != BLACKBOX_FROZEN)
+            continue;
+
+        writeBlackboxFile();
+
+        blackboxHead = 0;
+        blackboxCount = 0;
+        lastSampleFallen = true; // Only a new fall after recovering triggers again
+        blackboxState = BLACKBOX_RECORDING;
+    }
+}
+
+void initBlackbox()
+{
+    xTaskCreatePinnedToCore(blackboxWriterTask, "blackbox", 4096, NULL, 1, &blackboxTask, 0);
+}
+
+void blackboxSample(const ControlSample &sample)
+{
+    if (blackboxState == BLACKBOX_FROZEN)
+        return;
+
+    blackboxRing[blackboxHead] = sample;
+    blackboxHead = (blackboxHead + 1) % BLACKBOX_SAMPLES;
+    if (blackboxCount < BLACKBOX_SAMPLES)
+        blackboxCount++;
+
+    if (blackboxState == BLACKBOX_POST_TRIGGER)
+    {
+        if (--blackboxPostRemaining == 0 && blackboxTask != NULL)
+        {
+            blackboxState = BLACKBOX_FROZEN;
+            xTaskNotifyGive(blackboxTask);
+        }
+        return;
+    }
+
+    // Trigger on the tick an armed robot crosses the fall limits
+    bool fallen = (sample.flags & SAMPLE_ARMED) && (sample.flags & SAMPLE_FALLEN);
+    if (fallen && !lastSampleFallen)
+    {
+        blackboxPostRemaining = BLACKBOX_POST_SAMPLES;
+        blackboxTriggerMs = millis();
+        blackboxState = BLACKBOX_POST_TRIGGER;
+    }
+    lastSampleFallen = fallen;
+}
+
+bool isBlackboxFileName(const char *name)
+{
+    if (strncmp(name, "fall-", 5) != 0 || strchr(name, '/') != NULL)
+        return false;
+    const char *ext = strrchr(name, '.');
+    return ext != NULL && strcmp(ext, ".bin") == 0;
+}
+
+size_t listBlackboxFiles(char *buf, size_t size)
+{
+    size_t len = 0;
+    appendJson(buf, size, len, "{\"files\":[");
+    File dir = LittleFS.open(BLACKBOX_DIR);
+    if (dir && dir.isDirectory())
+    {
+        bool first = true;
+        File file = dir.openNextFile();
+        while (file)
+        {
+            if (isBlackboxFileName(file.name()))
+            {
+                appendJson(buf, size, len, "%s{\"name\":\"%s\",\"size\":%u}", first ? "" : ",", file.name(), (unsigned)file.size());
+                first = false;
+            }
+            file.close();
+            file = dir.openNextFile();
+        }
+        dir.close();
+    }
+    appendJson(buf, size, len, "]}");
+    return len;
+}
@@ -0,0 +1,34 @@
+#ifndef BLACKBOX_H
+#define BLACKBOX_H
+
+#include <Arduino.h>
+#include "capture.h"
+
+// Fall recorder: the last few seconds of control ticks are kept in a ring and
+// written to LittleFS (/blackbox/fall-NNNN.bin) when the robot falls over.
+
+// File header, followed by count ControlSample records, oldest first (little endian)
+struct __attribute__((packed)) BlackboxHeader
+{
+    uint32_t magic;        // BLACKBOX_MAGIC
+    uint16_t version;
+    uint16_t sampleSize;   // sizeof(ControlSample)
+    uint32_t count;
+    uint32_t triggerIndex; // Sample where the fall was detected
+    uint32_t sequence;     // Incident number, also in the file name
+    uint32_t uptimeMs;     // Time of the fall since boot
+};
+
+const uint32_t BLACKBOX_MAGIC = 0x584F4242; // "BBOX"
+const int BLACKBOX_KEEP_FILES = 5;
+
+void initBlackbox(); // Starts the writer task
+void blackboxSample(const ControlSample &sample); // Control loop only, every tick
+
+// Append {"name":..,"size":..} entries for the stored incidents, returns the length
+size_t listBlackboxFiles(char *buf, size_t size);
+bool isBlackboxFileName(const char *name);
+
+extern const char *const BLACKBOX_DIR;
+
+#endif
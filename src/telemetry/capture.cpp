@@ -0,0 +1,240 @@
+#include "capture.h"
+#include "wifi/wifi_manager.h"
+
+// Ring size: ~5 s at 200 Hz in internal RAM, ~2.5 min with PSRAM
+const uint32_t CAPTURE_RAM_SAMPLES = 1000;
+const uint32_t CAPTURE_PSRAM_SAMPLES = 30000;
+
+// Share of the ring kept from before the trigger
+const uint32_t CAPTURE_PRE_TRIGGER_PERCENT = 25;
+
+const char *const CAPTURE_ACTION_NAMES[] = {"arm", "trigger", "stop", NULL};
+const char *const CAPTURE_STATE_NAMES[] = {"idle", "armed", "triggered", "done"};
+
+static ControlSample *captureRing = NULL;
+static uint32_t captureCapacity = 0;
+static uint32_t captureHead = 0;        // Next slot to write
+static uint32_t captureCount = 0;       // Valid samples, up to captureCapacity
+static uint32_t capturePostTotal = 0;   // Samples to record after the trigger
+static uint32_t capturePostRecorded = 0;
+static uint32_t captureTriggerIndex = 0;
+static volatile CaptureState captureState = CAPTURE_IDLE;
+
+// Download cursor, one download at a time
+static volatile bool downloadActive = false;
+static bool downloadCsv = false;
+static uint32_t downloadOffset = 0; // Binary: byte offset; CSV: next sample (0 = header line)
+static char csvLine[160];
+static size_t csvLineLen = 0;
+static size_t csvLineSent = 0;
+
+// Guards the freeze/re-arm handover between the control loop and the web server
+static portMUX_TYPE captureMux = portMUX_INITIALIZER_UNLOCKED;
+
+void initCapture()
+{
+    uint32_t samples = psramFound() ? CAPTURE_PSRAM_SAMPLES : CAPTURE_RAM_SAMPLES;
+    size_t bytes = samples * sizeof(ControlSample);
+    captureRing = (ControlSample *)(psramFound() ? ps_malloc(bytes) : malloc(bytes));
+    if (captureRing == NULL)
+    {
+        Serial.printf("Capture buffer allocation failed (%u bytes)\n", (unsigned)bytes);
+        return;
+    }
+    captureCapacity = samples;
+    Serial.printf("Capture buffer: %u samples in %s\n", (unsigned)samples, psramFound() ? "PSRAM" : "RAM");
+}
+
+static void startRecording()
+{
+    captureHead = 0;
+    captureCount = 0;
+    capturePostTotal = 0;
+    capturePostRecorded = 0;
+    captureState = CAPTURE_ARMED;
+}
+
+static void freezeCapture()
+{
+    if (captureState == CAPTURE_TRIGGERED)
+        captureTriggerIndex = captureCount - min(capturePostRecorded, captureCount);
+    else
+        captureTriggerIndex = CAPTURE_NO_TRIGGER;
+    captureState = CAPTURE_DONE;
+}
+
+void captureControlAction(CaptureAction action)
+{
+    if (captureCapacity == 0)
+    {
+        SERIAL_PRINTLN("Capture: no buffer");
+        return;
+    }
+
+    switch (action)
+    {
+    case CAPTURE_ARM:
+    {
+        bool busy;
+        portENTER_CRITICAL(&captureMux);
+        busy = downloadActive;
+        if (!busy)
+            startRecording();
+        portEXIT_CRITICAL(&captureMux);
+        if (busy)
+        {
+            SERIAL_PRINTLN("Capture: download in progress, not armed");
+        }
+        break;
+    }
+    case CAPTURE_TRIGGER:
+        if (captureState != CAPTURE_ARMED)
+        {
+            // Trigger without arming: record a full post-trigger buffer
+            captureControlAction(CAPTURE_ARM);
+            if (captureState != CAPTURE_ARMED)
+                return;
+        }
+        {
+            uint32_t pre = min(captureCount, captureCapacity * CAPTURE_PRE_TRIGGER_PERCENT / 100);
+            capturePostTotal = captureCapacity - pre;
+            capturePostRecorded = 0;
+            captureState = CAPTURE_TRIGGERED;
+        }
+        break;
+    case CAPTURE_STOP:
+        if (captureState == CAPTURE_ARMED || captureState == CAPTURE_TRIGGERED)
+            freezeCapture();
+        break;
+    }
+    SERIAL_PRINTLN("Capture " + String(CAPTURE_STATE_NAMES[captureState]));
+}
+
+void captureSample(const ControlSample &sample)
+{
+    if (captureState != CAPTURE_ARMED && captureState != CAPTURE_TRIGGERED)
+        return;
+
+    captureRing[captureHead] = sample;
+    captureHead = (captureHead + 1) % captureCapacity;
+    if (captureCount < captureCapacity)
+        captureCount++;
+
+    if (captureState == CAPTURE_TRIGGERED && ++capturePostRecorded >= capturePostTotal)
+        freezeCapture();
+}
+
+CaptureState getCaptureState()
+{
+    return captureState;
+}
+
+uint32_t getCaptureCount()
+{
+    return captureCount;
+}
+
+// Sample in recording order, oldest first
+static const ControlSample &captureAt(uint32_t index)
+{
+    uint32_t start = captureCount < captureCapacity ? 0 : captureHead;
+    return captureRing[(start + index) % captureCapacity];
+}
+
+bool beginCaptureDownload(bool csv)
+{
+    bool ok;
+    portENTER_CRITICAL(&captureMux);
+    ok = !downloadActive && captureState == CAPTURE_DONE;
+    if (ok)
+        downloadActive = true;
+    portEXIT_CRITICAL(&captureMux);
+    if (!ok)
+        return false;
+
+    downloadCsv = csv;
+    downloadOffset = 0;
+    csvLineLen = 0;
+    csvLineSent = 0;
+    return true;
+}
+
+void endCaptureDownload()
+{
+    downloadActive = false;
+}
+
+static size_t readBinaryChunk(uint8_t *buffer, size_t maxLen)
+{
+    CaptureHeader header = {CAPTURE_MAGIC, 1, sizeof(ControlSample), captureCount, captureTriggerIndex};
+    uint32_t total = sizeof(header) + captureCount * sizeof(ControlSample);
+    size_t written = 0;
+
+    while (written < maxLen && downloadOffset < total)
+    {
+        const uint8_t *src;
+        size_t available;
+        if (downloadOffset < sizeof(header))
+        {
+            src = (const uint8_t *)&header + downloadOffset;
+            available = sizeof(header) - downloadOffset;
+        }
+        else
+        {
+            uint32_t pos = downloadOffset - sizeof(header);
+            uint32_t within = pos % sizeof(ControlSample);
+            src = (const uint8_t *)&captureAt(pos / sizeof(ControlSample)) + within;
+            available = sizeof(ControlSample) - within;
+        }
+        size_t n = min(available, maxLen - written);
+        memcpy(buffer + written, src, n);
+        written += n;
+        downloadOffset += n;
+    }
+    return written;
+}
+
+static void formatCsvLine(uint32_t line)
+{
+    if (line == 0)
+    {
+        csvLineLen = snprintf(csvLine, sizeof(csvLine),
+                              "time_us,gyro_x,gyro_y,gyro_z,accel_x,accel_y,accel_z,angle,setpoint,p,i,d,left,right,flags,trigger\n");
+        return;
+    }
+
+    uint32_t index = line - 1;
+    const ControlSample &s = captureAt(index);
+    csvLineLen = snprintf(csvLine, sizeof(csvLine), "%lu,%d,%d,%d,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%d,%d,%u,%d\n",
+                          (unsigned long)s.timeUs, s.gyro[0], s.gyro[1], s.gyro[2], s.accel[0], s.accel[1], s.accel[2],
+                          s.angle, s.setpoint, s.pTerm, s.iTerm, s.dTerm, s.leftDuty, s.rightDuty, s.flags,
+                          index == captureTriggerIndex ? 1 : 0);
+}
+
+static size_t readCsvChunk(uint8_t *buffer, size_t maxLen)
+{
+    size_t written = 0;
+    while (written < maxLen)
+    {
+        if (csvLineSent == csvLineLen)
+        {
+            if (downloadOffset > captureCount)
+                break;
+            formatCsvLine(downloadOffset++);
+            csvLineSent = 0;
+        }
+        size_t n = min(csvLineLen - csvLineSent, maxLen - written);
+        memcpy(buffer + written, csvLine + csvLineSent, n);
+        written += n;
+        csvLineSent += n;
+    }
+    return written;
+}
+
+// Fill one chunk of the response, 0 ends it
+size_t readCaptureChunk(uint8_t *buffer, size_t maxLen)
+{
+    if (!downloadActive)
+        return 0;
+    return downloadCsv ? readCsvChunk(buffer, maxLen) : readBinaryChunk(buffer, maxLen);
+}
@@ -0,0 +1,52 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <Arduino.h>
+#include "control_sample.h"
+
+enum CaptureState
+{
+    CAPTURE_IDLE,      // Nothing recorded since boot
+    CAPTURE_ARMED,     // Recording into the ring, keeps the newest samples
+    CAPTURE_TRIGGERED, // Recording the post-trigger part
+    CAPTURE_DONE,      // Frozen by the end of the post-trigger part or by a stop, ready to download
+    CAPTURE_STATE_COUNT
+};
+
+enum CaptureAction
+{
+    CAPTURE_ARM,
+    CAPTURE_TRIGGER,
+    CAPTURE_STOP
+};
+
+extern const char *const CAPTURE_ACTION_NAMES[];
+extern const char *const CAPTURE_STATE_NAMES[];
+
+// Binary download header, followed by count ControlSample records (little endian)
+struct __attribute__((packed)) CaptureHeader
+{
+    uint32_t magic;       // CAPTURE_MAGIC
+    uint16_t version;
+    uint16_t sampleSize;  // sizeof(ControlSample)
+    uint32_t count;
+    uint32_t triggerIndex; // Index of the first post-trigger sample, or CAPTURE_NO_TRIGGER
+};
+
+const uint32_t CAPTURE_MAGIC = 0x54504143; // "CAPT"
+const uint32_t CAPTURE_NO_TRIGGER = 0xFFFFFFFF; // Stopped while armed, before any trigger
+
+void initCapture(); // Allocates the ring, from PSRAM when present
+void captureControlAction(CaptureAction action); // Control loop only
+void captureSample(const ControlSample &sample); // Control loop only, every tick
+
+CaptureState getCaptureState();
+uint32_t getCaptureCount();
+
+// Download side (web server task). beginCaptureDownload() fails unless a
+// capture is frozen; arming is refused until endCaptureDownload().
+bool beginCaptureDownload(bool csv);
+size_t readCaptureChunk(uint8_t *buffer, size_t maxLen);
+void endCaptureDownload();
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef CONTROL_SAMPLE_H
+#define CONTROL_SAMPLE_H
+
+// No Arduino dependencies, shared with the host tools in tools/
+#include <stdint.h>
+
+// One control tick, as recorded by the capture and black-box buffers
+struct __attribute__((packed)) ControlSample
+{
+    uint32_t timeUs;  // IMU read time (ImuSample::timeUs)
+    int16_t gyro[3];  // Calibrated IMU counts, as fed to the estimator
+    int16_t accel[3];
+    float angle;      // Estimated tilt (degrees)
+    float setpoint;   // Profiled target plus lean offset (degrees)
+    float pTerm;
+    float iTerm;
+    float dTerm;
+    int8_t leftDuty;  // Applied motor duty (-100 to 100)
+    int8_t rightDuty;
+    uint8_t flags;    // SAMPLE_ARMED | SAMPLE_FALLEN | SAMPLE_IMU_STALE
+    uint8_t reserved;
+};
+
+const uint8_t SAMPLE_ARMED = 0x01;
+const uint8_t SAMPLE_FALLEN = 0x02;
+const uint8_t SAMPLE_IMU_STALE = 0x04; // IMU read failed, last good sample repeated
+
+#endif
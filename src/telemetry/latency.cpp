@@ -0,0 +1,92 @@
+#include "latency.h"
+#include "wifi/ws_streams.h"
+#include "wifi/json_format.h"
+
+static const char *const LATENCY_STAGE_NAMES[] = {"network", "queue", "actuation", "total"};
+static const char *const LATENCY_PATH_NAMES[] = {"drive", "command"};
+
+struct LatencyWindow
+{
+    uint32_t samples[LATENCY_WINDOW];
+    int head;
+    int count;
+};
+
+static LatencyWindow latencyWindows[LATENCY_PATH_COUNT][LATENCY_STAGE_COUNT];
+
+static char latencyReply[STREAM_FRAME_SIZE];
+
+static void addSample(LatencyWindow &window, uint32_t value)
+{
+    window.samples[window.head] = value;
+    window.head = (window.head + 1) % LATENCY_WINDOW;
+    if (window.count < LATENCY_WINDOW)
+        window.count++;
+}
+
+void recordLatency(LatencyPath path, const LatencyTrace &trace)
+{
+    LatencyWindow *windows = latencyWindows[path];
+    uint32_t end = trace.actuatedUs ? trace.actuatedUs : trace.appliedUs;
+
+    // A command stamped before it was received means the offset estimate is off, skip the origin stages
+    bool origin = trace.originUs != 0 && (int32_t)(trace.receivedUs - trace.originUs) >= 0;
+    if (origin)
+    {
+        addSample(windows[LATENCY_NETWORK], trace.receivedUs - trace.originUs);
+        addSample(windows[LATENCY_TOTAL], end - trace.originUs);
+    }
+    addSample(windows[LATENCY_QUEUE], trace.appliedUs - trace.receivedUs);
+    if (trace.actuatedUs)
+        addSample(windows[LATENCY_ACTUATION], trace.actuatedUs - trace.appliedUs);
+}
+
+// Sorted copy of the window, small enough for an insertion sort once a second
+static void latencyPercentiles(const LatencyWindow &window, float *p50, float *p90, float *p99)
+{
+    uint32_t sorted[LATENCY_WINDOW];
+    int n = window.count;
+    for (int i = 0; i < n; i++)
+    {
+        uint32_t value = window.samples[i];
+        int j = i;
+        while (j > 0 && sorted[j - 1] > value)
+        {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = value;
+    }
+    *p50 = sorted[n * 50 / 100] / 1000.0;
+    *p90 = sorted[n * 90 / 100] / 1000.0;
+    *p99 = sorted[n * 99 / 100] / 1000.0;
+}
+
+void sendLatencyReport()
+{
+    if (!streamHasSubscribers(STREAM_LATENCY))
+        return;
+
+    // Milliseconds, [p50, p90, p99] per stage with samples
+    size_t len = 0;
+    bool ok = appendJson(latencyReply, sizeof(latencyReply), len, "{\"type\":\"latency\"");
+    for (int path = 0; path < LATENCY_PATH_COUNT && ok; path++)
+    {
+        ok = appendJson(latencyReply, sizeof(latencyReply), len, ",\"%s\":{", LATENCY_PATH_NAMES[path]);
+        bool first = true;
+        for (int stage = 0; stage < LATENCY_STAGE_COUNT && ok; stage++)
+        {
+            const LatencyWindow &window = latencyWindows[path][stage];
+            if (window.count == 0)
+                continue;
+            float p50, p90, p99;
+            latencyPercentiles(window, &p50, &p90, &p99);
+            ok = appendJson(latencyReply, sizeof(latencyReply), len, "%s\"%s\":[%.1f,%.1f,%.1f]", first ? "" : ",",
+                            LATENCY_STAGE_NAMES[stage], p50, p90, p99);
+            first = false;
+        }
+        ok = ok && appendJson(latencyReply, sizeof(latencyReply), len, "}");
+    }
+    if (ok && appendJson(latencyReply, sizeof(latencyReply), len, "}"))
+        publishStream(STREAM_LATENCY, latencyReply, len);
+}
@@ -0,0 +1,43 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <Arduino.h>
+
+// End-to-end command latency. The dashboard estimates the robot clock offset
+// with WebSocket ping/pong and stamps commands with their origin time in robot
+// micros(); the firmware adds receive, apply and (for drive commands) PWM
+// actuation stamps. Percentiles over a sliding window go out on the latency stream.
+
+enum LatencyStage
+{
+    LATENCY_NETWORK,   // Origin to receive (depends on the clock offset estimate)
+    LATENCY_QUEUE,     // Receive to apply at a control tick
+    LATENCY_ACTUATION, // Apply to the next PWM update (drive commands only)
+    LATENCY_TOTAL,     // Origin to PWM update, or to apply for other commands
+    LATENCY_STAGE_COUNT
+};
+
+enum LatencyPath
+{
+    LATENCY_DRIVE,   // Joystick frames, through to the motors
+    LATENCY_COMMAND, // Queued JSON commands, up to the control tick applying them
+    LATENCY_PATH_COUNT
+};
+
+const int LATENCY_WINDOW = 128;
+
+// Stamps for one command, 0 where not known. Control loop task only.
+struct LatencyTrace
+{
+    uint32_t originUs;
+    uint32_t receivedUs;
+    uint32_t appliedUs;
+    uint32_t actuatedUs;
+};
+
+void recordLatency(LatencyPath path, const LatencyTrace &trace);
+
+// Publish p50/p90/p99 per stage on the latency stream, call periodically
+void sendLatencyReport();
+
+#endif
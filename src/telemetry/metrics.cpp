@@ -0,0 +1,210 @@
+#include "metrics.h"
+#include "scheduler/scheduler.h"
+#include "scheduler/load_shed.h"
+#include "control/joystick.h"
+#include "udp_sink.h"
+#include "control/command_queue.h"
+#include "gyro/gyro.h"
+#include "self_balancing/balance.h"
+#include "wifi/wifi_manager.h"
+#include "wifi/ws_streams.h"
+#include "wifi/json_format.h"
+
+const size_t METRICS_BUFFER_SIZE = 8192;
+const int MAX_RTOS_TASKS = 32;
+
+static char metricsBuffer[METRICS_BUFFER_SIZE];
+static volatile bool metricsBusy = false;
+static portMUX_TYPE metricsMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Per-second figures from sampleMetrics()
+static float loopRateHz = 0;
+static float controlLoad = 0;
+static uint32_t lastSampleUs = 0;
+static uint32_t lastAttitudeRuns = 0;
+static uint64_t lastBusyUs = 0;
+
+void sampleMetrics()
+{
+    uint32_t now = micros();
+    uint64_t busyUs = 0;
+    uint32_t attitudeRuns = 0;
+    for (int i = 0; i < getTaskCount(); i++)
+    {
+        const ScheduledTask &task = getTask(i);
+        busyUs += task.totalExecUs;
+        if (i == 0)
+            attitudeRuns = task.runs; // The first task is the attitude loop
+    }
+
+    if (lastSampleUs != 0)
+    {
+        float elapsed = (now - lastSampleUs) / 1000000.0;
+        loopRateHz = (attitudeRuns - lastAttitudeRuns) / elapsed;
+        controlLoad = (busyUs - lastBusyUs) / 1000000.0 / elapsed;
+    }
+    lastSampleUs = now;
+    lastAttitudeRuns = attitudeRuns;
+    lastBusyUs = busyUs;
+}
+
+// Bounded writer; output past the end of the buffer is dropped whole lines at a time
+struct MetricsWriter
+{
+    char *buf;
+    size_t size;
+    size_t len;
+};
+
+static void metricHeader(MetricsWriter &w, const char *name, const char *type, const char *help)
+{
+    appendJson(w.buf, w.size, w.len, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void metricValue(MetricsWriter &w, const char *name, double value)
+{
+    appendJson(w.buf, w.size, w.len, "%s %.10g\n", name, value);
+}
+
+static void metricLabeled(MetricsWriter &w, const char *name, const char *label, const char *labelValue, double value)
+{
+    appendJson(w.buf, w.size, w.len, "%s{%s=\"%s\"} %.10g\n", name, label, labelValue, value);
+}
+
+static void metric(MetricsWriter &w, const char *name, const char *type, const char *help, double value)
+{
+    metricHeader(w, name, type, help);
+    metricValue(w, name, value);
+}
+
+static void renderSchedulerMetrics(MetricsWriter &w)
+{
+    // Static: only one render runs at a time (metricsBusy)
+    static ScheduledTask tasks[MAX_SCHEDULED_TASKS];
+    int n = getTaskStats(tasks, MAX_SCHEDULED_TASKS);
+
+    metric(w, "robot_loop_rate_hz", "gauge", "Attitude loop rate over the last second", loopRateHz);
+    metric(w, "robot_control_task_load_ratio", "gauge", "Share of the last second spent in scheduled tasks", controlLoad);
+
+    metricHeader(w, "robot_task_runs_total", "counter", "Scheduled task runs");
+    for (int i = 0; i < n; i++)
+        metricLabeled(w, "robot_task_runs_total", "task", tasks[i].name, tasks[i].runs);
+    metricHeader(w, "robot_task_overruns_total", "counter", "Scheduled task runs over budget");
+    for (int i = 0; i < n; i++)
+        metricLabeled(w, "robot_task_overruns_total", "task", tasks[i].name, tasks[i].overruns);
+    metricHeader(w, "robot_task_exec_max_us", "gauge", "Longest scheduled task run");
+    for (int i = 0; i < n; i++)
+        metricLabeled(w, "robot_task_exec_max_us", "task", tasks[i].name, tasks[i].maxExecUs);
+    metricHeader(w, "robot_task_deadline_misses_total", "counter", "Runs that finished after the next period was due");
+    for (int i = 0; i < n; i++)
+        metricLabeled(w, "robot_task_deadline_misses_total", "task", tasks[i].name, tasks[i].deadlineMisses);
+    metricHeader(w, "robot_task_late_max_us", "gauge", "Worst start delay after the due time");
+    for (int i = 0; i < n; i++)
+        metricLabeled(w, "robot_task_late_max_us", "task", tasks[i].name, tasks[i].maxLateUs);
+    metric(w, "robot_shed_level", "gauge", "Load shedding level (0 none, 1 telemetry, 2 console, 3 display)", loadShedLevel());
+    metricHeader(w, "robot_task_exec_seconds_total", "counter", "Time spent in scheduled tasks");
+    for (int i = 0; i < n; i++)
+        metricLabeled(w, "robot_task_exec_seconds_total", "task", tasks[i].name, tasks[i].totalExecUs / 1000000.0);
+}
+
+static void renderRtosMetrics(MetricsWriter &w)
+{
+#if configUSE_TRACE_FACILITY
+    static TaskStatus_t rtosTasks[MAX_RTOS_TASKS];
+    uint32_t totalRunTime = 0;
+    int n = uxTaskGetSystemState(rtosTasks, MAX_RTOS_TASKS, &totalRunTime);
+
+    metricHeader(w, "robot_rtos_task_stack_free_bytes", "gauge", "Minimum free stack of each FreeRTOS task");
+    for (int i = 0; i < n; i++)
+        metricLabeled(w, "robot_rtos_task_stack_free_bytes", "task", rtosTasks[i].pcTaskName, rtosTasks[i].usStackHighWaterMark);
+#if configGENERATE_RUN_TIME_STATS
+    metricHeader(w, "robot_rtos_task_runtime_ratio", "gauge", "Share of run time used by each FreeRTOS task since boot");
+    for (int i = 0; i < n; i++)
+        metricLabeled(w, "robot_rtos_task_runtime_ratio", "task", rtosTasks[i].pcTaskName,
+                      totalRunTime ? (double)rtosTasks[i].ulRunTimeCounter / totalRunTime : 0);
+#endif
+#endif
+}
+
+static void renderStreamMetrics(MetricsWriter &w)
+{
+    StreamClientStats stats[MAX_STREAM_CLIENTS];
+    int n = getStreamClientStats(stats, MAX_STREAM_CLIENTS);
+    char id[12];
+
+    metricHeader(w, "robot_ws_stream_queue_depth", "gauge", "Frames waiting per WebSocket client");
+    for (int i = 0; i < n; i++)
+    {
+        snprintf(id, sizeof(id), "%lu", (unsigned long)stats[i].id);
+        metricLabeled(w, "robot_ws_stream_queue_depth", "client", id, stats[i].queueDepth);
+    }
+    metricHeader(w, "robot_ws_stream_dropped_total", "counter", "Frames dropped from full client queues");
+    for (int i = 0; i < n; i++)
+    {
+        snprintf(id, sizeof(id), "%lu", (unsigned long)stats[i].id);
+        metricLabeled(w, "robot_ws_stream_dropped_total", "client", id, stats[i].dropped);
+    }
+}
+
+static size_t renderMetrics(char *buf, size_t size)
+{
+    MetricsWriter w = {buf, size, 0};
+    buf[0] = 0;
+
+    metric(w, "robot_uptime_seconds", "gauge", "Time since boot", millis() / 1000.0);
+    renderSchedulerMetrics(w);
+    renderRtosMetrics(w);
+
+    metric(w, "robot_heap_free_bytes", "gauge", "Free heap", ESP.getFreeHeap());
+    metric(w, "robot_heap_min_free_bytes", "gauge", "Lowest free heap since boot", ESP.getMinFreeHeap());
+    metric(w, "robot_heap_largest_block_bytes", "gauge", "Largest allocatable heap block", ESP.getMaxAllocHeap());
+
+    metric(w, "robot_ws_clients", "gauge", "Connected WebSocket clients", ws.count());
+    renderStreamMetrics(w);
+
+    metric(w, "robot_command_queue_depth", "gauge", "Commands waiting for the control loop", pendingCommands());
+    metric(w, "robot_commands_posted_total", "counter", "Commands posted to the control loop", commandStats.posted);
+    metric(w, "robot_commands_dropped_total", "counter", "Commands dropped on a full queue", commandStats.dropped);
+    metric(w, "robot_command_latency_max_us", "gauge", "Longest post-to-apply command latency", commandStats.maxLatencyUs);
+    metric(w, "robot_udp_batches_sent_total", "counter", "UDP telemetry datagrams sent", udpSinkStats.sent);
+    metric(w, "robot_udp_batches_dropped_total", "counter", "UDP telemetry batches dropped with the sender busy", udpSinkStats.dropped);
+    metric(w, "robot_udp_send_errors_total", "counter", "UDP telemetry datagrams refused by the network stack", udpSinkStats.sendErrors);
+    metric(w, "robot_joystick_frames_total", "counter", "Joystick frames accepted", joystickStats.frames);
+    metric(w, "robot_joystick_stale_total", "counter", "Joystick frames dropped as out of order", joystickStats.stale);
+    metric(w, "robot_joystick_overwritten_total", "counter", "Joystick frames replaced before being applied", joystickStats.overwritten);
+    metric(w, "robot_joystick_timeouts_total", "counter", "Joystick streams stopped on timeout", joystickStats.timeouts);
+    metric(w, "robot_joystick_age_us", "gauge", "Receive-to-apply age of the last joystick frame", joystickStats.lastAgeUs);
+    metric(w, "robot_joystick_age_max_us", "gauge", "Longest receive-to-apply joystick frame age", joystickStats.maxAgeUs);
+
+    metric(w, "robot_imu_read_errors_total", "counter", "Short I2C reads from the IMU", imuHealth.readErrors);
+    metric(w, "robot_imu_bus_recoveries_total", "counter", "I2C bus recoveries", imuHealth.recoveries);
+    metric(w, "robot_imu_faults_total", "counter", "IMU silent past the fault timeout", imuHealth.faults);
+    metric(w, "robot_imu_faulted", "gauge", "IMU currently faulted, motors disarmed", imuHealth.faulted);
+    metric(w, "robot_fault_latched", "gauge", "Disarmed after an IMU fault until an arm command", balanceState.faultLatched);
+
+    metric(w, "robot_wifi_connected", "gauge", "Station connected", getWiFiState() == WIFI_STATE_CONNECTED);
+    metric(w, "robot_wifi_rssi_dbm", "gauge", "Station signal strength", getWiFiState() == WIFI_STATE_CONNECTED ? WiFi.RSSI() : 0);
+    metric(w, "robot_wifi_reconnects_total", "counter", "Station links lost after connecting", wifiStats.reconnects);
+    metric(w, "robot_wifi_connect_failures", "gauge", "Consecutive failed connection attempts", wifiStats.failures);
+
+    return w.len;
+}
+
+const char *beginMetricsRender(size_t &len)
+{
+    bool busy;
+    portENTER_CRITICAL(&metricsMux);
+    busy = metricsBusy;
+    metricsBusy = true;
+    portEXIT_CRITICAL(&metricsMux);
+    if (busy)
+        return NULL;
+
+    len = renderMetrics(metricsBuffer, sizeof(metricsBuffer));
+    return metricsBuffer;
+}
+
+void endMetricsRender()
+{
+    metricsBusy = false;
+}
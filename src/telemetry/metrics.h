@@ -0,0 +1,16 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+
+// Runtime counters in the Prometheus text exposition format, served on /metrics
+
+// Derive per-second rates (loop rate, control-task load); call once a second
+void sampleMetrics();
+
+// Render into the shared buffer. Returns NULL while a previous scrape is
+// still being sent; otherwise call endMetricsRender() once the response is done.
+const char *beginMetricsRender(size_t &len);
+void endMetricsRender();
+
+#endif
@@ -0,0 +1,61 @@
+#include "udp_batch.h"
+#include <string.h>
+
+void startUdpBatch(UdpBatch &batch, uint32_t firstSample, uint16_t decimation)
+{
+    batch.header.magic = UDP_BATCH_MAGIC;
+    batch.header.version = UDP_BATCH_VERSION;
+    batch.header.sampleSize = sizeof(ControlSample);
+    batch.header.sequence = 0; // Assigned when sent
+    batch.header.firstSample = firstSample;
+    batch.header.count = 0;
+    batch.header.decimation = decimation;
+    batch.header.senderDropped = 0;
+}
+
+bool addUdpSample(UdpBatch &batch, const ControlSample &sample)
+{
+    if (batch.header.count < UDP_BATCH_SAMPLES)
+        batch.samples[batch.header.count++] = sample;
+    return batch.header.count == UDP_BATCH_SAMPLES;
+}
+
+size_t udpBatchSize(const UdpBatch &batch)
+{
+    return sizeof(UdpBatchHeader) + batch.header.count * sizeof(ControlSample);
+}
+
+int parseUdpBatch(const void *data, size_t len, UdpBatchHeader &header, const ControlSample **samples)
+{
+    if (len < sizeof(UdpBatchHeader))
+        return -1;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != UDP_BATCH_MAGIC || header.version != UDP_BATCH_VERSION ||
+        header.sampleSize != sizeof(ControlSample) || header.count > UDP_BATCH_SAMPLES ||
+        len != sizeof(UdpBatchHeader) + header.count * sizeof(ControlSample))
+        return -1;
+    *samples = (const ControlSample *)((const uint8_t *)data + sizeof(UdpBatchHeader));
+    return header.count;
+}
+
+bool accountUdpBatch(UdpLossStats &stats, const UdpBatchHeader &header)
+{
+    if (stats.started && (int32_t)(header.sequence - stats.nextSequence) < 0)
+    {
+        stats.late++;
+        return false;
+    }
+
+    if (stats.started)
+    {
+        stats.lostDatagrams += header.sequence - stats.nextSequence;
+        stats.lostSamples += header.firstSample - stats.nextSample;
+    }
+    stats.started = true;
+    stats.nextSequence = header.sequence + 1;
+    stats.nextSample = header.firstSample + header.count;
+    stats.datagrams++;
+    stats.samples += header.count;
+    stats.senderDropped = header.senderDropped;
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef UDP_BATCH_H
+#define UDP_BATCH_H
+
+// UDP telemetry packet format. No Arduino dependencies, shared with
+// tools/udp_telemetry so the receiver decodes exactly what the robot sends.
+#include <stddef.h>
+#include "control_sample.h"
+
+// One datagram: header followed by count ControlSample records (little endian)
+struct __attribute__((packed)) UdpBatchHeader
+{
+    uint32_t magic;         // UDP_BATCH_MAGIC
+    uint16_t version;
+    uint16_t sampleSize;    // sizeof(ControlSample)
+    uint32_t sequence;      // Per datagram sent; a gap is a lost datagram
+    uint32_t firstSample;   // Index of samples[0] in the stream; a gap is lost samples
+    uint16_t count;
+    uint16_t decimation;    // Control ticks per sample
+    uint32_t senderDropped; // Batches the robot could not send (sender busy), cumulative
+};
+
+const uint32_t UDP_BATCH_MAGIC = 0x4D4C5455; // "UTLM"
+const uint16_t UDP_BATCH_VERSION = 1;
+
+// 24 + 34 * 40 = 1384 bytes, fits a single 1500-byte MTU frame
+const int UDP_BATCH_SAMPLES = 34;
+
+struct __attribute__((packed)) UdpBatch
+{
+    UdpBatchHeader header;
+    ControlSample samples[UDP_BATCH_SAMPLES];
+};
+
+void startUdpBatch(UdpBatch &batch, uint32_t firstSample, uint16_t decimation);
+bool addUdpSample(UdpBatch &batch, const ControlSample &sample); // True once the batch is full
+size_t udpBatchSize(const UdpBatch &batch);                      // Bytes to send
+
+// Validates a received datagram, returns the sample count or -1
+int parseUdpBatch(const void *data, size_t len, UdpBatchHeader &header, const ControlSample **samples);
+
+// Receiver-side datagram and sample accounting, start from all zeros
+struct UdpLossStats
+{
+    bool started;
+    uint32_t nextSequence;
+    uint32_t nextSample;
+    uint32_t datagrams;
+    uint32_t samples;
+    uint32_t lostDatagrams; // Sequence gaps
+    uint32_t lostSamples;   // Sample index gaps, network and sender drops together
+    uint32_t late;          // Older than the newest seen (reordered or duplicated), not written
+    uint32_t senderDropped; // Reported by the robot
+    uint32_t invalid;       // Rejected by parseUdpBatch(), counted by the caller
+};
+
+// Account for a parsed batch, true if it is new and its samples should be kept
+bool accountUdpBatch(UdpLossStats &stats, const UdpBatchHeader &header);
+
+#endif
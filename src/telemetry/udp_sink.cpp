@@ -0,0 +1,130 @@
+#include "udp_sink.h"
+#include "udp_batch.h"
+#include "wifi/wifi_manager.h"
+#include <WiFiUdp.h>
+#include <Preferences.h>
+
+UdpSinkStats udpSinkStats = {0, 0, 0};
+
+static UdpSinkConfig udpConfig = {false, 0, 0, 1};
+static portMUX_TYPE udpMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Double buffer: the control loop fills one batch while the sender task sends the other
+static UdpBatch udpBatches[2];
+static uint8_t fillIndex = 0;
+static volatile uint8_t sendIndex = 0;
+static volatile bool sendPending = false;
+static uint32_t nextSample = 0;
+static uint16_t tickCount = 0;
+static bool batchStarted = false;
+
+static TaskHandle_t udpTask = NULL;
+static WiFiUDP udp;
+
+// Low-priority sender on core 0, woken by the control loop when a batch is full
+static void udpSenderTask(void *param)
+{
+    uint32_t sequence = 0;
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (!sendPending)
+            continue;
+
+        UdpSinkConfig config = getUdpSinkConfig();
+        WiFiState state = getWiFiState();
+        if (config.enabled && (state == WIFI_STATE_CONNECTED || state == WIFI_STATE_AP))
+        {
+            UdpBatch &batch = udpBatches[sendIndex];
+            batch.header.sequence = sequence++;
+            batch.header.senderDropped = udpSinkStats.dropped;
+            if (udp.beginPacket(IPAddress(config.host), config.port) &&
+                udp.write((const uint8_t *)&batch, udpBatchSize(batch)) == udpBatchSize(batch) &&
+                udp.endPacket())
+                udpSinkStats.sent++;
+            else
+                udpSinkStats.sendErrors++;
+        }
+        sendPending = false;
+    }
+}
+
+void initUdpSink()
+{
+    Preferences prefs;
+    prefs.begin("udp", true);
+    UdpSinkConfig config;
+    config.enabled = prefs.getBool("enabled", false);
+    config.host = prefs.getUInt("host", 0);
+    config.port = prefs.getUShort("port", 0);
+    config.decimation = prefs.getUShort("decimation", 1);
+    prefs.end();
+    if (config.host == 0 || config.port == 0 || config.decimation == 0)
+        config.enabled = false;
+
+    portENTER_CRITICAL(&udpMux);
+    udpConfig = config;
+    portEXIT_CRITICAL(&udpMux);
+
+    xTaskCreatePinnedToCore(udpSenderTask, "udp", 3072, NULL, 1, &udpTask, 0);
+    if (config.enabled)
+        Serial.printf("UDP telemetry to %s:%u\n", IPAddress(config.host).toString().c_str(), config.port);
+}
+
+UdpSinkConfig getUdpSinkConfig()
+{
+    portENTER_CRITICAL(&udpMux);
+    UdpSinkConfig config = udpConfig;
+    portEXIT_CRITICAL(&udpMux);
+    return config;
+}
+
+void setUdpSinkConfig(const UdpSinkConfig &config)
+{
+    portENTER_CRITICAL(&udpMux);
+    udpConfig = config;
+    portEXIT_CRITICAL(&udpMux);
+
+    Preferences prefs;
+    prefs.begin("udp", false);
+    prefs.putBool("enabled", config.enabled);
+    prefs.putUInt("host", config.host);
+    prefs.putUShort("port", config.port);
+    prefs.putUShort("decimation", config.decimation);
+    prefs.end();
+}
+
+void udpSinkSample(const ControlSample &sample)
+{
+    // Plain reads: a config change landing mid-tick only affects this one sample
+    if (!udpConfig.enabled || udpTask == NULL)
+    {
+        batchStarted = false;
+        return;
+    }
+    if (++tickCount < udpConfig.decimation)
+        return;
+    tickCount = 0;
+
+    UdpBatch &batch = udpBatches[fillIndex];
+    if (!batchStarted)
+    {
+        startUdpBatch(batch, nextSample, udpConfig.decimation);
+        batchStarted = true;
+    }
+    nextSample++;
+    if (!addUdpSample(batch, sample))
+        return;
+
+    batchStarted = false;
+    if (sendPending)
+    {
+        // Sender still busy with the previous batch; the receiver sees the sample index gap
+        udpSinkStats.dropped++;
+        return;
+    }
+    sendIndex = fillIndex;
+    fillIndex ^= 1;
+    sendPending = true;
+    xTaskNotifyGive(udpTask);
+}
@@ -0,0 +1,35 @@
+#ifndef UDP_SINK_H
+#define UDP_SINK_H
+
+#include <Arduino.h>
+#include "control_sample.h"
+
+// Optional UDP telemetry: every control tick (or every Nth) is batched and
+// sent to a configured host, see udp_batch.h for the format and
+// tools/udp_telemetry for the receiver. Unlike the WebSocket a lost datagram
+// costs only its own samples and nothing queues up behind it.
+
+struct UdpSinkConfig
+{
+    bool enabled;
+    uint32_t host; // IPv4 address
+    uint16_t port;
+    uint16_t decimation; // Control ticks per sample, 1 sends every tick
+};
+
+struct UdpSinkStats
+{
+    uint32_t sent;       // Datagrams handed to the network stack
+    uint32_t dropped;    // Batches discarded because the previous one was still being sent
+    uint32_t sendErrors; // Network stack refused the datagram
+};
+
+extern UdpSinkStats udpSinkStats;
+
+void initUdpSink(); // Loads the configuration from NVS and starts the sender task
+void udpSinkSample(const ControlSample &sample); // Control loop only, every tick
+
+UdpSinkConfig getUdpSinkConfig();
+void setUdpSinkConfig(const UdpSinkConfig &config); // Applies and stores in NVS
+
+#endif
@@ -0,0 +1,55 @@
+#include "json_format.h"
+
+// Append a JSON string literal, escaping quotes, backslashes and control characters
+bool appendJsonString(char *buf, size_t size, size_t &len, const char *text)
+{
+  size_t pos = len;
+  if (pos + 1 >= size)
+    return false;
+  buf[pos++] = '"';
+  for (const char *p = text; *p; p++)
+  {
+    unsigned char c = *p;
+    if (c == '"' || c == '\\')
+    {
+      if (pos + 2 >= size)
+        return false;
+      buf[pos++] = '\\';
+      buf[pos++] = c;
+    }
+    else if (c < 0x20)
+    {
+      if (pos + 6 >= size)
+        return false;
+      pos += snprintf(buf + pos, size - pos, "\\u%04x", c);
+    }
+    else
+    {
+      if (pos + 1 >= size)
+        return false;
+      buf[pos++] = c;
+    }
+  }
+  if (pos + 1 >= size)
+    return false;
+  buf[pos++] = '"';
+  buf[pos] = 0;
+  len = pos;
+  return true;
+}
+
+// Append printf output, leaving len unchanged if it does not fit
+bool appendJson(char *buf, size_t size, size_t &len, const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(buf + len, size - len, fmt, args);
+  va_end(args);
+  if (n < 0 || len + n >= size)
+  {
+    buf[len] = 0;
+    return false;
+  }
+  len += n;
+  return true;
+}
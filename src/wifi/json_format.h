@@ -0,0 +1,11 @@
+#ifndef JSON_FORMAT_H
+#define JSON_FORMAT_H
+
+#include <Arduino.h>
+
+// Bounded JSON writers for fixed buffers. Both append at buf + len and return
+// false, leaving len unchanged, if the text does not fit in size.
+bool appendJsonString(char *buf, size_t size, size_t &len, const char *text);
+bool appendJson(char *buf, size_t size, size_t &len, const char *fmt, ...);
+
+#endif
@@ -0,0 +1,79 @@
+#include "json_pool.h"
+
+// Every block is prefixed with its size so reallocate() can copy it
+struct BlockHeader
+{
+    size_t size;
+};
+
+static size_t alignUp(size_t n)
+{
+    return (n + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+}
+
+JsonPoolAllocator::JsonPoolAllocator(uint8_t *pool, size_t capacity)
+    : _pool(pool), _capacity(capacity), _used(0), _last(NULL), _failures(0)
+{
+}
+
+void *JsonPoolAllocator::allocate(size_t size)
+{
+    size_t needed = alignUp(sizeof(BlockHeader) + size);
+    if (_used + needed > _capacity)
+    {
+        _failures++;
+        return NULL;
+    }
+
+    uint8_t *block = _pool + _used;
+    ((BlockHeader *)block)->size = size;
+    _used += needed;
+    _last = block;
+    return block + sizeof(BlockHeader);
+}
+
+void JsonPoolAllocator::deallocate(void *ptr)
+{
+    // Reclaimed by reset()
+}
+
+void *JsonPoolAllocator::reallocate(void *ptr, size_t newSize)
+{
+    if (ptr == NULL)
+        return allocate(newSize);
+
+    uint8_t *block = (uint8_t *)ptr - sizeof(BlockHeader);
+    BlockHeader *header = (BlockHeader *)block;
+
+    // Grow or shrink the most recent block in place
+    if (block == _last)
+    {
+        size_t start = block - _pool;
+        size_t needed = alignUp(sizeof(BlockHeader) + newSize);
+        if (start + needed > _capacity)
+        {
+            _failures++;
+            return NULL;
+        }
+        _used = start + needed;
+        header->size = newSize;
+        return ptr;
+    }
+
+    if (newSize <= header->size)
+    {
+        header->size = newSize;
+        return ptr;
+    }
+
+    void *moved = allocate(newSize);
+    if (moved != NULL)
+        memcpy(moved, ptr, header->size);
+    return moved;
+}
+
+void JsonPoolAllocator::reset()
+{
+    _used = 0;
+    _last = NULL;
+}
@@ -0,0 +1,32 @@
+#ifndef JSON_POOL_H
+#define JSON_POOL_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Bump allocator over a fixed static pool for ArduinoJson documents.
+// Nothing is freed individually; reset() reclaims the whole pool once the
+// document has been cleared, so parsing never touches the heap.
+class JsonPoolAllocator : public ArduinoJson::Allocator
+{
+public:
+    JsonPoolAllocator(uint8_t *pool, size_t capacity);
+
+    void *allocate(size_t size) override;
+    void deallocate(void *ptr) override;
+    void *reallocate(void *ptr, size_t newSize) override;
+
+    void reset();
+    size_t used() const { return _used; }
+    size_t capacity() const { return _capacity; }
+    uint32_t failures() const { return _failures; }
+
+private:
+    uint8_t *_pool;
+    size_t _capacity;
+    size_t _used;
+    uint8_t *_last; // Most recent block, the only one that can grow in place
+    uint32_t _failures;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include "web_assets.h"
+#include <LittleFS.h>
+
+struct WebAsset
+{
+  const char *path;
+  const char *contentType;
+  char etag[24]; // Quoted strong ETag from /etags.txt, empty if unknown
+};
+
+static WebAsset webAssets[] = {
+    {"/index.html", "text/html", ""},
+    {"/script.js", "application/javascript", ""},
+    {"/plotter.js", "application/javascript", ""},
+    {"/styles.css", "text/css", ""},
+    {"/favicon.ico", "image/x-icon", ""},
+};
+
+const int WEB_ASSET_COUNT = sizeof(webAssets) / sizeof(webAssets[0]);
+
+// Revalidate on every load; unchanged files cost a 304 with no body
+static const char *ASSET_CACHE_CONTROL = "no-cache";
+
+static WebAsset *findAsset(const char *path)
+{
+  for (int i = 0; i < WEB_ASSET_COUNT; i++)
+  {
+    if (strcmp(webAssets[i].path, path) == 0)
+      return &webAssets[i];
+  }
+  return NULL;
+}
+
+// Load "<path> <hash>" lines written by scripts/build_web_assets.py
+void initWebAssets()
+{
+  File file = LittleFS.open("/etags.txt", "r");
+  if (!file)
+  {
+    Serial.println("No /etags.txt, web assets served without ETags");
+    return;
+  }
+
+  char line[64];
+  while (file.available())
+  {
+    size_t n = file.readBytesUntil('\n', line, sizeof(line) - 1);
+    line[n] = 0;
+
+    char *space = strchr(line, ' ');
+    if (space == NULL)
+      continue;
+    *space = 0;
+
+    WebAsset *asset = findAsset(line);
+    if (asset != NULL)
+      snprintf(asset->etag, sizeof(asset->etag), "\"%s\"", space + 1);
+  }
+  file.close();
+}
+
+void serveAsset(AsyncWebServerRequest *request, const char *path)
+{
+  WebAsset *asset = findAsset(path);
+  if (asset == NULL)
+  {
+    request->send(404);
+    return;
+  }
+
+  if (asset->etag[0] && request->hasHeader("If-None-Match") &&
+      request->getHeader("If-None-Match")->value() == asset->etag)
+  {
+    AsyncWebServerResponse *response = request->beginResponse(304);
+    response->addHeader("ETag", asset->etag);
+    response->addHeader("Cache-Control", ASSET_CACHE_CONTROL);
+    request->send(response);
+    return;
+  }
+
+  // The file response falls back to <path>.gz and adds Content-Encoding: gzip itself
+  AsyncWebServerResponse *response = request->beginResponse(LittleFS, asset->path, asset->contentType);
+  if (asset->etag[0])
+    response->addHeader("ETag", asset->etag);
+  response->addHeader("Cache-Control", ASSET_CACHE_CONTROL);
+  request->send(response);
+}
@@ -0,0 +1,12 @@
+#ifndef WEB_ASSETS_H
+#define WEB_ASSETS_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+// Dashboard files in LittleFS. The build stores them gzipped (<path>.gz)
+// together with /etags.txt; plain files are still served if present.
+void initWebAssets();
+void serveAsset(AsyncWebServerRequest *request, const char *path);
+
+#endif
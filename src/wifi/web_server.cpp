@@ -1,7 +1,21 @@
 #include "wifi_manager.h"
 #include "control/input_controller.h"
 #include "self_balancing/balance.h"
+#include "control/command_queue.h"
+#include "control/commands.h"
 #include <ArduinoJson.h>
+#include "json_pool.h"
+#include "ws_streams.h"
+#include "web_assets.h"
+#include "wifi_scan.h"
+#include "json_format.h"
+#include "telemetry/capture.h"
+#include "telemetry/blackbox.h"
+#include "telemetry/metrics.h"
+#include "scheduler/load_shed.h"
+#include "control/tuning.h"
+#include "control/joystick.h"
+#include "telemetry/udp_sink.h"
 
 bool ledState = 0;
 #define LED_PIN 2
@@ -10,19 +24,58 @@ bool ledState = 0;
 extern GyroOffsets gyroOffsets;
 extern AccelOffsets accelOffsets;
 extern float currentAngle;
-extern float targetAngle;
 
 // Create AsyncWebServer object on port 80
 AsyncWebServer server(80);
 AsyncWebSocket ws("/ws");
 
-// Network scan results
-String scannedNetworks = "";
-
 // Serial console buffer
 String serialBuffer = "";
 const int MAX_SERIAL_BUFFER = 1000; // Limit buffer size to prevent memory issues
 
+// Incoming WebSocket messages: fragments are reassembled here, single-frame
+// messages are parsed straight from the AsyncWebSocket buffer
+const size_t WS_MAX_MESSAGE = 512;
+static char wsMessage[WS_MAX_MESSAGE];
+static size_t wsMessageLen = 0;
+static uint32_t wsMessageClient = 0;
+static bool wsMessageDropped = false;
+
+// Fixed pool for the JSON document, reset before every parse
+const size_t WS_JSON_POOL_SIZE = 4096;
+static uint8_t wsJsonPool[WS_JSON_POOL_SIZE];
+static JsonPoolAllocator wsJsonAllocator(wsJsonPool, WS_JSON_POOL_SIZE);
+static JsonDocument wsDoc(&wsJsonAllocator);
+
+// Outgoing replies from the control loop are formatted here, then copied once
+// into a message buffer shared by every client
+static char wsReply[STREAM_FRAME_SIZE];
+
+// Tuning profile replies, formatted on the WebSocket task
+static char profileReply[1024];
+
+// Connection and controller status, pushed to clients only when it changes
+struct StatusSnapshot
+{
+  WiFiState wifiState;
+  uint32_t ip;
+  int rssi;
+  bool armed;
+  bool fallen;
+  bool imuFaulted;
+  bool faultLatched;
+  bool joystick;
+  ShedLevel shed;
+  CaptureState capture;
+};
+
+const uint32_t STATUS_HEARTBEAT_MS = 10000; // Full snapshot even when nothing changed
+const int STATUS_RSSI_HYSTERESIS = 4;       // dB change before RSSI is re-sent
+
+static StatusSnapshot lastStatus;
+static uint32_t lastStatusHeartbeatMs = 0;
+static volatile bool statusFullRequested = true; // Set when a client connects
+
 // Function prototypes for async handlers
 void handleStatus(AsyncWebServerRequest *request);
 void handleSaveWiFi(AsyncWebServerRequest *request);
@@ -32,6 +85,10 @@ void handleGetPID(AsyncWebServerRequest *request);
 void handleSetPID(AsyncWebServerRequest *request);
 void handleCalibrate(AsyncWebServerRequest *request);
 void handleClearConsole(AsyncWebServerRequest *request);
+void handleCapture(AsyncWebServerRequest *request);
+void handleBlackbox(AsyncWebServerRequest *request);
+void handleMetrics(AsyncWebServerRequest *request);
+void handleUdp(AsyncWebServerRequest *request);
 void initRoutes();
 
 void notifyClients()
@@ -39,110 +96,310 @@ void notifyClients()
   ws.textAll(String(ledState));
 }
 
-void handleWebSocketMessage(void *arg, uint8_t *data, size_t len)
+// Toggle the onboard LED and tell clients its new state
+void toggleLed()
 {
-  AwsFrameInfo *info = (AwsFrameInfo *)arg;
-  if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT)
+  ledState = !ledState;
+  digitalWrite(LED_PIN, ledState);
+  notifyClients();
+}
+
+// Send the serial console buffer to WebSocket clients
+void sendConsoleBuffer()
+{
+  if (serialBuffer.length() > 0)
   {
-    data[len] = 0;
-    String message = String((char *)data);
+    ws.textAll(serialBuffer);
+  }
+}
+
+// Fill a command's arguments from the JSON fields named in the command table
+CommandError parseJsonCommand(JsonDocument &doc, ControlCommand &cmd)
+{
+  CommandError error = parseCommandName(doc["type"].as<const char *>(), SRC_WS, cmd);
+  if (error != CMD_OK)
+    return error;
+
+  const CommandSpec &spec = commandSpec(cmd.type);
+  for (int i = 0; i < spec.argCount && error == CMD_OK; i++)
+  {
+    JsonVariant field = doc[spec.args[i].name];
+    if (field.isNull())
+      error = CMD_ERR_MISSING_ARG;
+    else if (field.is<const char *>())
+      error = setCommandArgText(cmd, i, field.as<const char *>());
+    else
+      error = setCommandArg(cmd, i, field.as<float>());
+  }
+  // Origin time in robot micros(), stamped by the dashboard for latency tracking
+  cmd.originUs = doc["origin"] | 0u;
+  return error;
+}
+
+// Append the fields of a tuning profile as a JSON object
+static bool appendTuningJson(char *buf, size_t size, size_t &len, const TuningProfile &tuning)
+{
+  bool ok = appendJson(buf, size, len, "{");
+  for (int i = 0; i < TUNING_FIELD_COUNT && ok; i++)
+    ok = appendJson(buf, size, len, "%s\"%s\":%.4f", i > 0 ? "," : "", TUNING_FIELDS[i].name, tuningField(tuning, i));
+  return ok && appendJson(buf, size, len, "}");
+}
+
+// Current tuning plus the stored profile names
+static size_t formatProfileList(char *buf, size_t size)
+{
+  char names[MAX_TUNING_PROFILES][TUNING_NAME_SIZE];
+  int count = listTuningProfiles(names, MAX_TUNING_PROFILES);
+
+  size_t len = 0;
+  appendJson(buf, size, len, "{\"type\":\"profiles\",\"active\":");
+  appendJsonString(buf, size, len, tuningProfileName());
+  appendJson(buf, size, len, ",\"modified\":%s,\"tuning\":", tuningModified() ? "true" : "false");
+  appendTuningJson(buf, size, len, latestTuning());
+  appendJson(buf, size, len, ",\"names\":[");
+  for (int i = 0; i < count; i++)
+    appendJson(buf, size, len, "%s\"%s\"", i > 0 ? "," : "", names[i]);
+  appendJson(buf, size, len, "]}");
+  return len;
+}
+
+// Field-by-field differences between two profiles
+static size_t formatProfileDiff(char *buf, size_t size, const char *fromName, const TuningProfile &from,
+                                const char *toName, const TuningProfile &to)
+{
+  size_t len = 0;
+  appendJson(buf, size, len, "{\"type\":\"profile-diff\",\"from\":\"%s\",\"to\":\"%s\",\"changes\":[", fromName, toName);
+  bool first = true;
+  for (int i = 0; i < TUNING_FIELD_COUNT; i++)
+  {
+    float a = tuningField(from, i);
+    float b = tuningField(to, i);
+    if (a == b)
+      continue;
+    appendJson(buf, size, len, "%s{\"field\":\"%s\",\"from\":%.4f,\"to\":%.4f}", first ? "" : ",", TUNING_FIELDS[i].name, a, b);
+    first = false;
+  }
+  appendJson(buf, size, len, "]}");
+  return len;
+}
 
-    if (message == "toggle")
+static void sendProfileError(AsyncWebSocketClient *client, const char *message)
+{
+  size_t len = 0;
+  appendJson(profileReply, sizeof(profileReply), len, "{\"type\":\"profile-error\",\"message\":\"%s\"}", message);
+  client->text(profileReply, len);
+}
+
+// Tuning profile API: profile-list, profile-load, profile-save, profile-diff and
+// profile-set (any subset of fields, staged together). Profile names are strings,
+// so these are handled here rather than through the command queue.
+static void handleProfileMessage(AsyncWebSocketClient *client, const char *type, JsonDocument &doc)
+{
+  const char *name = doc["name"] | "";
+
+  if (strcmp(type, "profile-diff") == 0)
+  {
+    // Stored profile against another stored one, or against the working profile
+    TuningProfile from, to;
+    const char *with = doc["with"] | "";
+    if (!readTuningProfile(name, from) || (with[0] && !readTuningProfile(with, to)))
+    {
+      sendProfileError(client, "no such profile");
+      return;
+    }
+    if (!with[0])
+    {
+      to = latestTuning();
+      with = "working";
+    }
+    size_t len = formatProfileDiff(profileReply, sizeof(profileReply), name, from, with, to);
+    client->text(profileReply, len);
+    return;
+  }
+
+  if (strcmp(type, "profile-load") == 0)
+  {
+    if (!loadTuningProfile(name))
     {
-      ledState = !ledState;
-      digitalWrite(LED_PIN, ledState);
-      ws.textAll(String(ledState));
+      sendProfileError(client, "no such profile");
+      return;
     }
-    else if (message == "get-buffer")
+    Serial.printf("Tuning profile '%s' loaded\n", name);
+  }
+  else if (strcmp(type, "profile-save") == 0)
+  {
+    if (!saveTuningProfile(name))
     {
-      // Send current serial buffer to the client
-      if (serialBuffer.length() > 0)
+      sendProfileError(client, isTuningProfileName(name) ? "write failed" : "invalid name");
+      return;
+    }
+    Serial.printf("Tuning profile '%s' saved\n", name);
+  }
+  else if (strcmp(type, "profile-set") == 0)
+  {
+    // Applied together under the tuning lock, so a command-queue edit in between is not lost
+    TuningEdit edits[TUNING_FIELD_COUNT];
+    int count = 0;
+    for (int i = 0; i < TUNING_FIELD_COUNT; i++)
+    {
+      JsonVariant field = doc[TUNING_FIELDS[i].name];
+      if (field.isNull())
+        continue;
+      if (!field.is<float>())
       {
-        ws.textAll(serialBuffer);
+        sendProfileError(client, "value not a number");
+        return;
       }
+      edits[count].field = i;
+      edits[count].value = field.as<float>();
+      edits[count].delta = false;
+      count++;
+    }
+    if (!editTuning(edits, count))
+    {
+      sendProfileError(client, "value out of range");
+      return;
+    }
+  }
+  else if (strcmp(type, "profile-list") != 0)
+  {
+    sendProfileError(client, "unknown profile command");
+    return;
+  }
+
+  // Every dashboard shows the current tuning, so changes go to all clients
+  size_t len = formatProfileList(profileReply, sizeof(profileReply));
+  if (strcmp(type, "profile-list") == 0)
+    client->text(profileReply, len);
+  else
+    broadcastText(profileReply, len);
+}
+
+// Broadcast text through one shared message buffer instead of a copy per client
+void broadcastText(const char *text, size_t len)
+{
+  AsyncWebSocketMessageBuffer *buffer = ws.makeBuffer(len);
+  if (buffer == NULL)
+    return;
+  memcpy(buffer->get(), text, len);
+  ws.textAll(buffer);
+}
+
+// Parse and post one complete message; data is not NUL-terminated
+void handleCommandMessage(AsyncWebSocketClient *client, const char *data, size_t len)
+{
+  uint32_t receivedUs = micros();
+  ControlCommand cmd;
+  cmd.type = CMD_COUNT;
+  CommandError error;
+  if (len > 0 && data[0] == '{')
+  {
+    wsDoc.clear();
+    wsJsonAllocator.reset();
+    if (deserializeJson(wsDoc, data, len))
+      return;
+    const char *type = wsDoc["type"] | "";
+    if (strcmp(type, "ping") == 0)
+    {
+      // Clock offset: the client pairs its send/receive times with ours (NTP style)
+      char pong[96];
+      int n = snprintf(pong, sizeof(pong), "{\"type\":\"pong\",\"t0\":%.3f,\"t1\":%lu,\"t2\":%lu}",
+                       wsDoc["t0"].as<double>(), (unsigned long)receivedUs, (unsigned long)micros());
+      client->text(pong, n);
+      return;
+    }
+    if (strncmp(type, "profile-", 8) == 0)
+    {
+      handleProfileMessage(client, type, wsDoc);
+      return;
+    }
+    error = parseJsonCommand(wsDoc, cmd);
+  }
+  else
+  {
+    // Plain-text commands such as "toggle" and "get-buffer"
+    char name[32];
+    if (len >= sizeof(name))
+      return;
+    memcpy(name, data, len);
+    name[len] = 0;
+    error = parseTextCommand(name, "", SRC_WS, cmd);
+  }
+
+  // Subscriptions belong to the connection, not the control loop
+  if (error == CMD_OK && cmd.type == CMD_SUBSCRIBE)
+  {
+    subscribeStream(client->id(), (StreamId)(int)cmd.args[0], cmd.args[1]);
+    return;
+  }
+
+  if (error == CMD_OK)
+    error = submitCommand(cmd);
+
+  if (cmd.type == CMD_SET_PID)
+  {
+    static const char PID_UPDATED[] = "{\"type\":\"pid-updated\",\"success\":true}";
+    static const char PID_FAILED[] = "{\"type\":\"pid-updated\",\"success\":false}";
+    if (error == CMD_OK)
+      broadcastText(PID_UPDATED, sizeof(PID_UPDATED) - 1);
+    else
+      broadcastText(PID_FAILED, sizeof(PID_FAILED) - 1);
+  }
+  if (error != CMD_OK)
+  {
+    Serial.printf("WS command rejected: %s\n", commandErrorString(error));
+  }
+}
+
+void handleWebSocketMessage(AsyncWebSocketClient *client, void *arg, uint8_t *data, size_t len)
+{
+  AwsFrameInfo *info = (AwsFrameInfo *)arg;
+
+  // Whole message in one frame and one event: parse in place
+  if (info->final && info->num == 0 && info->index == 0 && info->len == len)
+  {
+    if (info->opcode == WS_TEXT)
+      handleCommandMessage(client, (const char *)data, len);
+    else if (info->opcode == WS_BINARY && !handleJoystickFrame(client->id(), data, len))
+      Serial.printf("WS binary frame from #%u not understood (%u bytes)\n", client->id(), (unsigned)len);
+    return;
+  }
+
+  // Fragmented message (several frames) or a frame split across events
+  bool firstChunk = info->num == 0 && info->index == 0;
+  if (firstChunk)
+  {
+    wsMessageLen = 0;
+    wsMessageClient = client->id();
+    wsMessageDropped = (info->message_opcode != WS_TEXT);
+  }
+  else if (client->id() != wsMessageClient)
+  {
+    return; // Interleaved message from another client, keep the current one
+  }
+
+  if (!wsMessageDropped)
+  {
+    if (wsMessageLen + len > WS_MAX_MESSAGE)
+    {
+      wsMessageDropped = true;
+      Serial.printf("WS message from #%u too long, dropped\n", client->id());
     }
     else
     {
-      // Try to parse as JSON
-      JsonDocument doc;
-      DeserializationError error = deserializeJson(doc, message);
-      if (!error)
-      {
-        String type = doc["type"];
-        if (type == "get-pid")
-        {
-          String json = "{";
-          json += "\"type\":\"pid-values\",";
-          json += "\"kp\":" + String(balancePID.kp, 3) + ",";
-          json += "\"ki\":" + String(balancePID.ki, 3) + ",";
-          json += "\"kd\":" + String(balancePID.kd, 3);
-          json += "}";
-          ws.textAll(json);
-        }
-        else if (type == "set-pid")
-        {
-          float kp = doc["kp"];
-          float ki = doc["ki"];
-          float kd = doc["kd"];
-          balancePID.kp = kp;
-          balancePID.ki = ki;
-          balancePID.kd = kd;
-          SERIAL_PRINTLN("PID values updated via WS: Kp=" + String(kp, 3) + ", Ki=" + String(ki, 3) + ", Kd=" + String(kd, 3));
-          String response = "{\"type\":\"pid-updated\",\"success\":true}";
-          ws.textAll(response);
-        }
-        else if (type == "adjust-pid")
-        {
-          String param = doc["param"];
-          float delta = doc["delta"];
-          if (param == "kp")
-          {
-            balancePID.kp += delta;
-            balancePID.kp = constrain(balancePID.kp, 0.0, 500.0);
-          }
-          else if (param == "ki")
-          {
-            balancePID.ki += delta;
-            balancePID.ki = constrain(balancePID.ki, 0.0, 100.0);
-          }
-          else if (param == "kd")
-          {
-            balancePID.kd += delta;
-            balancePID.kd = constrain(balancePID.kd, 0.0, 100.0);
-          }
-          SERIAL_PRINTLN("PID adjusted via WS: " + param + " by " + String(delta, 3));
-          // Send back updated PID values
-          String json = "{";
-          json += "\"type\":\"pid-values\",";
-          json += "\"kp\":" + String(balancePID.kp, 3) + ",";
-          json += "\"ki\":" + String(balancePID.ki, 3) + ",";
-          json += "\"kd\":" + String(balancePID.kd, 3);
-          json += "}";
-          ws.textAll(json);
-        }
-        else if (type == "get-target-angle")
-        {
-          String json = "{";
-          json += "\"type\":\"target-angle\",";
-          json += "\"value\":" + String(targetAngle, 3);
-          json += "}";
-          ws.textAll(json);
-        }
-        else if (type == "adjust-target-angle")
-        {
-          float delta = doc["delta"];
-          handleTargetAngle(delta, 0);
-          SERIAL_PRINTLN("Target angle adjusted via WS by " + String(delta, 3) + " to " + String(targetAngle, 3));
-          // Send back updated target angle
-          String json = "{";
-          json += "\"type\":\"target-angle\",";
-          json += "\"value\":" + String(targetAngle, 3);
-          json += "}";
-          ws.textAll(json);
-        }
-      }
+      memcpy(wsMessage + wsMessageLen, data, len);
+      wsMessageLen += len;
     }
   }
+
+  // Last chunk of the last frame
+  if (info->final && info->index + len == info->len)
+  {
+    if (!wsMessageDropped)
+      handleCommandMessage(client, wsMessage, wsMessageLen);
+    wsMessageLen = 0;
+    wsMessageDropped = true;
+  }
 }
 
 void onEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type,
@@ -152,6 +409,8 @@ void onEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType
   {
   case WS_EVT_CONNECT:
     Serial.printf("WebSocket client #%u connected from %s\n", client->id(), client->remoteIP().toString().c_str());
+    addStreamClient(client->id());
+    statusFullRequested = true;
     // Send current serial buffer to new client
     if (serialBuffer.length() > 0)
     {
@@ -160,9 +419,10 @@ void onEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType
     break;
   case WS_EVT_DISCONNECT:
     Serial.printf("WebSocket client #%u disconnected\n", client->id());
+    removeStreamClient(client->id());
     break;
   case WS_EVT_DATA:
-    handleWebSocketMessage(arg, data, len);
+    handleWebSocketMessage(client, arg, data, len);
     break;
   case WS_EVT_PONG:
   case WS_EVT_ERROR:
@@ -182,34 +442,12 @@ void initWebServerWithWebSocket()
   server.begin();
 }
 
-// Function to scan available networks
-void scanNetworks()
-{
-  SERIAL_PRINTLN("Scanning for WiFi networks...");
-  int n = WiFi.scanNetworks();
-  scannedNetworks = "";
-  if (n == 0)
-  {
-    scannedNetworks = "<option>No networks found</option>";
-  }
-  else
-  {
-    for (int i = 0; i < n; ++i)
-    {
-      String ssid = WiFi.SSID(i);
-      int rssi = WiFi.RSSI(i);
-      String encryption = (WiFi.encryptionType(i) == WIFI_AUTH_OPEN) ? "Open" : "Secured";
-      scannedNetworks += "<option value='" + ssid + "'>" + ssid + " (" + String(rssi) + "dBm) " + encryption + "</option>";
-    }
-  }
-  SERIAL_PRINTLN("Scan complete. Found " + String(n) + " networks.");
-}
-
 // Add message to serial buffer and broadcast to WebSocket clients
 void addToSerialBuffer(String message)
 {
-  // Only proceed if there are connected clients
+  // Only proceed if there are connected clients, and not while shedding load
   if (ws.count() == 0) return;
+  if (loadShedLevel() >= SHED_CONSOLE) return;
 
   // Add timestamp
   String timestampedMessage = "[" + String(millis()) + "] " + message + "\n";
@@ -224,60 +462,189 @@ void addToSerialBuffer(String message)
     serialBuffer = serialBuffer.substring(excess);
   }
 
-  // Broadcast to WebSocket clients (only if queue not full)
-  if (ws.availableForWriteAll())
+  // Queue for console subscribers; slow clients drop their own oldest lines
+  publishStream(STREAM_CONSOLE, timestampedMessage.c_str(), timestampedMessage.length());
+}
+
+// Send angle data to WebSocket clients
+void sendAngleData(float angle, float target, float commanded, uint32_t sampleUs)
+{
+  // Only format if someone is subscribed
+  if (!streamHasSubscribers(STREAM_TILT)) return;
+
+  // t: IMU read time of the sample, lets the dashboard measure how stale it is when drawn
+  int len = snprintf(wsReply, sizeof(wsReply), "{\"type\":\"angle\",\"current\":%.2f,\"target\":%.2f,\"commanded\":%.2f,\"t\":%lu}",
+                     angle, target, commanded, (unsigned long)sampleUs);
+  publishStream(STREAM_TILT, wsReply, len);
+}
+
+// Send PID terms to subscribed clients
+void sendPIDTerms(float pTerm, float iTerm, float dTerm, float output)
+{
+  if (!streamHasSubscribers(STREAM_PID)) return;
+
+  int len = snprintf(wsReply, sizeof(wsReply), "{\"type\":\"pid-terms\",\"p\":%.3f,\"i\":%.3f,\"d\":%.3f,\"output\":%.2f}",
+                     pTerm, iTerm, dTerm, output);
+  publishStream(STREAM_PID, wsReply, len);
+}
+
+// Send per-client stream and command queue statistics to subscribed clients
+void sendStreamMetrics()
+{
+  if (!streamHasSubscribers(STREAM_METRICS)) return;
+
+  StreamClientStats stats[MAX_STREAM_CLIENTS];
+  int n = getStreamClientStats(stats, MAX_STREAM_CLIENTS);
+
+  int len = snprintf(wsReply, sizeof(wsReply), "{\"type\":\"metrics\",\"cmdLatencyUs\":%lu,\"cmdDropped\":%lu,"
+                     "\"joyAgeUs\":%lu,\"joyMaxAgeUs\":%lu,\"clients\":[",
+                     (unsigned long)commandStats.lastLatencyUs, (unsigned long)commandStats.dropped,
+                     (unsigned long)joystickStats.lastAgeUs, (unsigned long)joystickStats.maxAgeUs);
+  for (int i = 0; i < n && len < (int)sizeof(wsReply); i++)
+  {
+    len += snprintf(wsReply + len, sizeof(wsReply) - len, "%s{\"id\":%lu,\"depth\":%u,\"dropped\":%lu,\"decimation\":%u}",
+                    i ? "," : "", (unsigned long)stats[i].id, stats[i].queueDepth, (unsigned long)stats[i].dropped, stats[i].decimation);
+  }
+  if (len < (int)sizeof(wsReply) - 2)
   {
-    ws.textAll(timestampedMessage);
+    len += snprintf(wsReply + len, sizeof(wsReply) - len, "]}");
+    publishStream(STREAM_METRICS, wsReply, len);
   }
 }
 
-// Send angle data to WebSocket clients
-void sendAngleData(float angle, float target)
+// Send current PID gains to WebSocket clients
+void sendPIDValues()
+{
+  if (ws.count() == 0) return;
+
+  // Staged values, the control loop swaps them in before its next tick
+  TuningProfile tuning = latestTuning();
+  int len = snprintf(wsReply, sizeof(wsReply), "{\"type\":\"pid-values\",\"kp\":%.3f,\"ki\":%.3f,\"kd\":%.3f}",
+                     tuning.kp, tuning.ki, tuning.kd);
+  broadcastText(wsReply, len);
+}
+
+// Send current target angle to WebSocket clients
+void sendTargetAngle()
 {
-  // Only send if there are connected clients
   if (ws.count() == 0) return;
 
-  String jsonData = "{";
-  jsonData += "\"type\":\"angle\",";
-  jsonData += "\"current\":" + String(angle, 2) + ",";
-  jsonData += "\"target\":" + String(target, 2);
-  jsonData += "}";
+  int len = snprintf(wsReply, sizeof(wsReply), "{\"type\":\"target-angle\",\"value\":%.3f}", latestTuning().targetAngle);
+  broadcastText(wsReply, len);
+}
+
+static const char *controllerStateName(const StatusSnapshot &status)
+{
+  if (status.imuFaulted)
+    return "imu-fault";
+  if (status.faultLatched)
+    return "fault-latched";
+  if (!status.armed)
+    return "disarmed";
+  return status.fallen ? "fallen" : "balancing";
+}
 
-  // Only send if WebSocket can accept messages (prevents queue overflow)
-  if (ws.availableForWriteAll())
+// Push changed status fields to every client, everything on connect and on the heartbeat
+void sendStatusUpdates()
+{
+  if (ws.count() == 0)
+    return;
+
+  StatusSnapshot now;
+  now.wifiState = getWiFiState();
+  bool apMode = now.wifiState == WIFI_STATE_AP;
+  now.ip = apMode ? (uint32_t)WiFi.softAPIP() : (uint32_t)WiFi.localIP();
+  now.rssi = now.wifiState == WIFI_STATE_CONNECTED ? WiFi.RSSI() : 0;
+  now.armed = balanceState.armed;
+  now.fallen = balanceState.fallen;
+  now.imuFaulted = imuHealth.faulted;
+  now.faultLatched = balanceState.faultLatched;
+  now.capture = getCaptureState();
+  now.shed = loadShedLevel();
+  now.joystick = joystickStats.active;
+
+  uint32_t nowMs = millis();
+  bool heartbeat = nowMs - lastStatusHeartbeatMs >= STATUS_HEARTBEAT_MS;
+  bool full = statusFullRequested || heartbeat;
+  bool network = full || now.wifiState != lastStatus.wifiState || now.ip != lastStatus.ip;
+  bool rssi = full || abs(now.rssi - lastStatus.rssi) >= STATUS_RSSI_HYSTERESIS;
+  bool controller = full || now.armed != lastStatus.armed || now.fallen != lastStatus.fallen ||
+                    now.imuFaulted != lastStatus.imuFaulted || now.faultLatched != lastStatus.faultLatched || now.shed != lastStatus.shed ||
+                    now.joystick != lastStatus.joystick;
+  bool capture = full || now.capture != lastStatus.capture;
+  if (!network && !rssi && !controller && !capture)
+    return;
+
+  size_t len = 0;
+  appendJson(wsReply, sizeof(wsReply), len, "{\"type\":\"status\"");
+  if (full)
+  {
+    appendJson(wsReply, sizeof(wsReply), len, ",\"full\":true,\"uptime\":%lu", (unsigned long)nowMs);
+  }
+  if (network)
   {
-    ws.textAll(jsonData);
+    appendJson(wsReply, sizeof(wsReply), len, ",\"mode\":\"%s\",\"state\":\"%s\",\"connected\":%s,\"ip\":\"%s\",\"ssid\":",
+               apMode ? "AP" : "STA", wifiStateName(now.wifiState),
+               now.wifiState == WIFI_STATE_CONNECTED ? "true" : "false", IPAddress(now.ip).toString().c_str());
+    appendJsonString(wsReply, sizeof(wsReply), len, apMode ? ap_ssid : ssid);
   }
+  if (rssi)
+  {
+    appendJson(wsReply, sizeof(wsReply), len, ",\"rssi\":%d", now.rssi);
+  }
+  if (controller)
+  {
+    appendJson(wsReply, sizeof(wsReply), len, ",\"armed\":%s,\"controller\":\"%s\",\"imuErrors\":%lu,\"imuRecoveries\":%lu,\"shed\":\"%s\",\"joystick\":%s",
+               now.armed ? "true" : "false", controllerStateName(now),
+               (unsigned long)imuHealth.readErrors, (unsigned long)imuHealth.recoveries, SHED_LEVEL_NAMES[now.shed],
+               now.joystick ? "true" : "false");
+  }
+  if (capture)
+  {
+    appendJson(wsReply, sizeof(wsReply), len, ",\"capture\":\"%s\",\"captureSamples\":%lu",
+               CAPTURE_STATE_NAMES[now.capture], (unsigned long)getCaptureCount());
+  }
+  if (!appendJson(wsReply, sizeof(wsReply), len, "}"))
+    return;
+
+  broadcastText(wsReply, len);
+  lastStatus = now;
+  statusFullRequested = false;
+  if (full)
+    lastStatusHeartbeatMs = nowMs;
 }
 
 // Handle status endpoint
 void handleStatus(AsyncWebServerRequest *request)
 {
   String json = "{";
-  if (WiFi.getMode() == WIFI_AP)
-  {
-    IPAddress apIP = WiFi.softAPIP();
-    json += "\"mode\":\"AP\",";
-    json += "\"ssid\":\"" + String(ap_ssid) + "\",";
-    json += "\"ip\":\"" + apIP.toString() + "\"";
-    SERIAL_PRINTLN("AP Mode - IP: " + apIP.toString());
-  }
-  else if (WiFi.status() == WL_CONNECTED)
+  WiFiState state = getWiFiState();
+  if (state == WIFI_STATE_CONNECTED)
   {
     IPAddress localIP = WiFi.localIP();
     json += "\"mode\":\"STA\",";
     json += "\"connected\":true,";
     json += "\"ssid\":\"" + WiFi.SSID() + "\",";
-    json += "\"ip\":\"" + localIP.toString() + "\"";
-    // Serial.println("STA Mode - IP: " + localIP.toString());
+    json += "\"ip\":\"" + localIP.toString() + "\",";
+    json += "\"rssi\":" + String(WiFi.RSSI()) + ",";
+  }
+  else if (state == WIFI_STATE_AP)
+  {
+    IPAddress apIP = WiFi.softAPIP();
+    json += "\"mode\":\"AP\",";
+    json += "\"ssid\":\"" + String(ap_ssid) + "\",";
+    json += "\"ip\":\"" + apIP.toString() + "\",";
   }
   else
   {
     json += "\"mode\":\"STA\",";
     json += "\"connected\":false,";
-    json += "\"ssid\":\"" + String(ssid) + "\"";
-    SERIAL_PRINTLN("Not connected to WiFi");
+    json += "\"ssid\":\"" + String(ssid) + "\",";
   }
+  json += "\"state\":\"" + String(wifiStateName(state)) + "\",";
+  json += "\"failures\":" + String(wifiStats.failures) + ",";
+  json += "\"reconnects\":" + String(wifiStats.reconnects) + ",";
+  json += "\"armed\":" + String(balanceState.armed ? "true" : "false");
   json += "}";
 
   request->send(200, "application/json", json);
@@ -299,39 +666,17 @@ void handleSaveWiFi(AsyncWebServerRequest *request)
   {
     ssidValue.toCharArray(ssid, sizeof(ssid));
     passValue.toCharArray(password, sizeof(password));
+    preferences.begin("wifi", false);
     preferences.putString("ssid", ssid);
     preferences.putString("password", password);
+    preferences.end();
 
     SERIAL_PRINTLN("WiFi credentials updated: " + ssidValue);
 
-    // Attempt reconnection
-    WiFi.disconnect(true);
-    delay(1000);
-    WiFi.mode(WIFI_STA);
-    delay(500);
-    WiFi.begin(ssid, password);
-
-    // Wait for connection
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 20)
-    {
-      delay(500);
-      attempts++;
-    }
+    // The connection manager reconnects from the main loop; watch /status for the result
+    requestWiFiReconnect();
 
-    if (WiFi.status() == WL_CONNECTED)
-    {
-      SERIAL_PRINTLN("Reconnected successfully!");
-      SERIAL_PRINT("New IP Address: ");
-      SERIAL_PRINTLN(WiFi.localIP().toString());
-      // Server is already started
-    }
-    else
-    {
-      SERIAL_PRINTLN("Reconnection failed");
-    }
-
-    request->send(200, "application/json", "{\"success\":true,\"message\":\"WiFi credentials saved\"}");
+    request->send(200, "application/json", "{\"success\":true,\"message\":\"WiFi credentials saved, reconnecting\"}");
   }
   else
   {
@@ -340,37 +685,120 @@ void handleSaveWiFi(AsyncWebServerRequest *request)
 }
 
 // Handle scan networks endpoint
+// Return the cached scan immediately and refresh it in the background;
+// clients get a scan-results WebSocket message when the new list is ready
 void handleScanNetworks(AsyncWebServerRequest *request)
 {
-  scanNetworks();
-  String json = "{\"networks\":[";
-  // Parse scannedNetworks to JSON
-  int start = 0;
-  int end = scannedNetworks.indexOf("<option", start);
-  bool first = true;
-  while (end != -1)
+  static char json[SCAN_JSON_SIZE];
+  requestScan();
+  formatScanJson(json, sizeof(json));
+  request->send(200, "application/json", json);
+}
+
+// Stream the frozen capture buffer as CSV (default) or packed binary (?format=bin).
+// The response is generated chunk by chunk from the ring, never built in memory.
+void handleCapture(AsyncWebServerRequest *request)
+{
+  bool csv = !(request->hasParam("format") && request->getParam("format")->value() == "bin");
+  if (!beginCaptureDownload(csv))
   {
-    int valueStart = scannedNetworks.indexOf("value='", end) + 7;
-    int valueEnd = scannedNetworks.indexOf("'", valueStart);
-    String ssid = scannedNetworks.substring(valueStart, valueEnd);
+    request->send(409, "application/json", "{\"success\":false,\"message\":\"No finished capture, or a download is already running\"}");
+    return;
+  }
+
+  AsyncWebServerResponse *response = request->beginChunkedResponse(csv ? "text/csv" : "application/octet-stream",
+                                                                    [](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+                                                                    { return readCaptureChunk(buffer, maxLen); });
+  response->addHeader("Content-Disposition", csv ? "attachment; filename=capture.csv" : "attachment; filename=capture.bin");
+  request->onDisconnect(endCaptureDownload);
+  request->send(response);
+}
 
-    int textStart = scannedNetworks.indexOf(">", valueEnd) + 1;
-    int textEnd = scannedNetworks.indexOf("</option>", textStart);
-    String text = scannedNetworks.substring(textStart, textEnd);
+// List fall recordings, or download one with ?file=fall-NNNN.bin
+void handleBlackbox(AsyncWebServerRequest *request)
+{
+  if (!request->hasParam("file"))
+  {
+    char json[512];
+    listBlackboxFiles(json, sizeof(json));
+    request->send(200, "application/json", json);
+    return;
+  }
 
-    if (!first)
-      json += ",";
-    json += "{\"ssid\":\"" + ssid + "\",\"rssi\":\"" + text.substring(text.indexOf("(") + 1, text.indexOf(")")) + "\",\"encryption\":\"" + (text.indexOf("Open") != -1 ? "Open" : "Secured") + "\"}";
-    first = false;
+  const String &name = request->getParam("file")->value();
+  String path = String(BLACKBOX_DIR) + "/" + name;
+  if (!isBlackboxFileName(name.c_str()) || !LittleFS.exists(path))
+  {
+    request->send(404, "application/json", "{\"success\":false,\"message\":\"No such recording\"}");
+    return;
+  }
+  request->send(LittleFS, path, "application/octet-stream", true);
+}
 
-    start = textEnd + 9;
-    end = scannedNetworks.indexOf("<option", start);
+// UDP telemetry sink: GET reports the configuration and counters, POST with
+// host, port, enable and optionally decimation changes it
+void handleUdp(AsyncWebServerRequest *request)
+{
+  if (request->method() == HTTP_POST)
+  {
+    UdpSinkConfig config = getUdpSinkConfig();
+    if (request->hasParam("host", true))
+    {
+      IPAddress host;
+      if (!host.fromString(request->getParam("host", true)->value().c_str()))
+      {
+        request->send(400, "application/json", "{\"success\":false,\"message\":\"host must be an IPv4 address\"}");
+        return;
+      }
+      config.host = (uint32_t)host;
+    }
+    if (request->hasParam("port", true))
+    {
+      // toInt() gives 0 for non-numeric text, which is rejected with the rest
+      long port = request->getParam("port", true)->value().toInt();
+      if (port < 1 || port > 65535)
+      {
+        request->send(400, "application/json", "{\"success\":false,\"message\":\"port must be 1-65535\"}");
+        return;
+      }
+      config.port = port;
+    }
+    if (request->hasParam("decimation", true))
+      config.decimation = constrain(request->getParam("decimation", true)->value().toInt(), 1, 100);
+    if (request->hasParam("enable", true))
+      config.enabled = request->getParam("enable", true)->value() == "1";
+    if (config.enabled && (config.host == 0 || config.port == 0))
+    {
+      request->send(400, "application/json", "{\"success\":false,\"message\":\"host and port required\"}");
+      return;
+    }
+    setUdpSinkConfig(config);
+    Serial.printf("UDP telemetry %s: %s:%u\n", config.enabled ? "enabled" : "disabled",
+                  IPAddress(config.host).toString().c_str(), config.port);
   }
-  json += "]}";
 
+  UdpSinkConfig config = getUdpSinkConfig();
+  char json[192];
+  snprintf(json, sizeof(json), "{\"enabled\":%s,\"host\":\"%s\",\"port\":%u,\"decimation\":%u,\"sent\":%lu,\"dropped\":%lu,\"errors\":%lu}",
+           config.enabled ? "true" : "false", IPAddress(config.host).toString().c_str(), config.port, config.decimation,
+           (unsigned long)udpSinkStats.sent, (unsigned long)udpSinkStats.dropped, (unsigned long)udpSinkStats.sendErrors);
   request->send(200, "application/json", json);
 }
 
+// Prometheus scrape: rendered once into a static buffer and sent straight from it
+void handleMetrics(AsyncWebServerRequest *request)
+{
+  size_t len;
+  const char *text = beginMetricsRender(len);
+  if (text == NULL)
+  {
+    request->send(503, "text/plain", "Scrape in progress\n");
+    return;
+  }
+  request->onDisconnect(endMetricsRender);
+  request->send(request->beginResponse(200, "text/plain; version=0.0.4", (const uint8_t *)text, len));
+}
+
 // Handle control endpoint (for robot commands)
 void handleControl(AsyncWebServerRequest *request)
 {
@@ -380,13 +808,16 @@ void handleControl(AsyncWebServerRequest *request)
     return;
   }
 
-  String command = request->getParam("command", true)->value();
-  String value = request->hasParam("value", true) ? request->getParam("value", true)->value() : "";
+  const String &command = request->getParam("command", true)->value();
+  const char *value = request->hasParam("value", true) ? request->getParam("value", true)->value().c_str() : "";
 
-  SERIAL_PRINTLN("Robot command received: " + command + (value.length() > 0 ? " " + value : ""));
-
-  // Handle command using the controller
-  handleRobotCommand(command, value);
+  // Parsed and validated against the shared command table
+  CommandError error = handleRobotCommand(command.c_str(), value);
+  if (error != CMD_OK)
+  {
+    request->send(400, "application/json", String("{\"success\":false,\"message\":\"") + commandErrorString(error) + "\"}");
+    return;
+  }
 
   request->send(200, "application/json", "{\"success\":true,\"message\":\"Command received: " + command + "\"}");
 }
@@ -412,16 +843,22 @@ void handleSetPID(AsyncWebServerRequest *request)
     return;
   }
 
-  float kp = request->getParam("kp", true)->value().toFloat();
-  float ki = request->getParam("ki", true)->value().toFloat();
-  float kd = request->getParam("kd", true)->value().toFloat();
-
-  // Update PID values
-  balancePID.kp = kp;
-  balancePID.ki = ki;
-  balancePID.kd = kd;
+  ControlCommand cmd;
+  CommandError error = parseCommandName("set-pid", SRC_HTTP, cmd);
+  const CommandSpec &spec = commandSpec(CMD_SET_PID);
+  for (int i = 0; i < spec.argCount && error == CMD_OK; i++)
+  {
+    error = setCommandArgText(cmd, i, request->getParam(spec.args[i].name, true)->value().c_str());
+  }
 
-  SERIAL_PRINTLN("PID values updated: Kp=" + String(kp, 3) + ", Ki=" + String(ki, 3) + ", Kd=" + String(kd, 3));
+  // Applied by the control loop at the start of its next tick
+  if (error == CMD_OK)
+    error = submitCommand(cmd);
+  if (error != CMD_OK)
+  {
+    request->send(error == CMD_ERR_QUEUE_FULL ? 503 : 400, "application/json", String("{\"success\":false,\"message\":\"") + commandErrorString(error) + "\"}");
+    return;
+  }
 
   request->send(200, "application/json", "{\"success\":true,\"message\":\"PID values updated\"}");
 }
@@ -429,15 +866,16 @@ void handleSetPID(AsyncWebServerRequest *request)
 // Handle calibrate endpoint
 void handleCalibrate(AsyncWebServerRequest *request)
 {
-  SERIAL_PRINTLN("Starting sensor calibration...");
-
-  // Perform calibration
-  calibrateGyro(gyroOffsets);
-  calibrateAccel(accelOffsets);
+  // Calibration runs on the control loop, which stops the motors first
+  if (!postCommand(CMD_CALIBRATE, SRC_HTTP))
+  {
+    request->send(503, "application/json", "{\"success\":false,\"message\":\"Command queue full\"}");
+    return;
+  }
 
-  SERIAL_PRINTLN("Calibration completed");
+  SERIAL_PRINTLN("Sensor calibration queued");
 
-  request->send(200, "application/json", "{\"success\":true,\"message\":\"Calibration completed\"}");
+  request->send(200, "application/json", "{\"success\":true,\"message\":\"Calibration started\"}");
 }
 
 // Handle clear console endpoint
@@ -449,10 +887,11 @@ void handleClearConsole(AsyncWebServerRequest *request)
 
 void initRoutes()
 {
+  initWebAssets();
 
   // API endpoints
   server.on("/", HTTP_GET, [](AsyncWebServerRequest *request)
-            { request->send(LittleFS, "/index.html", "text/html"); });
+            { serveAsset(request, "/index.html"); });
   server.on("/status", HTTP_GET, handleStatus);
   server.on("/scan-networks", HTTP_GET, handleScanNetworks);
   server.on("/get-pid", HTTP_GET, handleGetPID);
@@ -462,14 +901,18 @@ void initRoutes()
   server.on("/control", HTTP_POST, handleControl);
   server.on("/set-pid", HTTP_POST, handleSetPID);
   server.on("/calibrate", HTTP_POST, handleCalibrate);
+  server.on("/capture", HTTP_GET, handleCapture);
+  server.on("/blackbox", HTTP_GET, handleBlackbox);
+  server.on("/metrics", HTTP_GET, handleMetrics);
+  server.on("/udp", HTTP_GET | HTTP_POST, handleUdp);
 
-  // Serve other static files
+  // Serve other static files (gzipped, with ETags)
   server.on("/script.js", HTTP_GET, [](AsyncWebServerRequest *request)
-            { request->send(LittleFS, "/script.js", "application/javascript"); });
+            { serveAsset(request, "/script.js"); });
   server.on("/plotter.js", HTTP_GET, [](AsyncWebServerRequest *request)
-            { request->send(LittleFS, "/plotter.js", "application/javascript"); });
+            { serveAsset(request, "/plotter.js"); });
   server.on("/styles.css", HTTP_GET, [](AsyncWebServerRequest *request)
-            { request->send(LittleFS, "/styles.css", "text/css"); });
+            { serveAsset(request, "/styles.css"); });
   server.on("/favicon.ico", HTTP_GET, [](AsyncWebServerRequest *request)
-            { request->send(LittleFS, "/favicon.ico", "image/x-icon"); });
+            { serveAsset(request, "/favicon.ico"); });
 }
\ No newline at end of file
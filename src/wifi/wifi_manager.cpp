@@ -1,4 +1,6 @@
 #include "wifi_manager.h"
+#include "wifi_scan.h"
+#include "boot/boot_timeline.h"
 
 // WiFi credentials
 char ssid[32] = "Slow_Network";
@@ -11,6 +13,135 @@ const char* ap_password = "robot_password";
 Preferences preferences;
 // WiFiServer server(80);
 
+// Reconnect policy: exponential backoff between attempts, AP only after
+// several consecutive failures so a short blip never drops the station
+WiFiPolicy wifiPolicy = {
+  10000,  // connectTimeoutMs
+  500,    // backoffMinMs
+  30000,  // backoffMaxMs
+  5,      // apFallbackFailures
+  60000   // apRetryMs
+};
+
+WiFiStats wifiStats = {WIFI_STATE_IDLE, 0, 0, 0};
+
+// Minimum time after starting an attempt before a disconnect event counts as
+// its failure (WiFi.begin() can report the previous link going down)
+const uint32_t WIFI_EVENT_GRACE_MS = 500;
+
+static uint32_t stateSinceMs = 0;   // When the current state was entered
+static uint32_t backoffMs = 0;      // Wait before the next attempt
+static volatile bool reconnectRequested = false; // Set from the web server task
+
+// Last access point, kept in Preferences so a reconnect can skip the full scan
+static uint8_t cachedBssid[6];
+static uint8_t cachedChannel = 0;
+static bool useCachedAp = false;
+
+// Set from the WiFi event task, consumed by updateWiFi()
+static volatile bool gotIpEvent = false;
+static volatile bool disconnectEvent = false;
+static volatile uint32_t disconnectAtMs = 0;
+static volatile uint8_t disconnectReason = 0;
+static uint8_t connectedBssid[6];
+static volatile uint8_t connectedChannel = 0;
+
+static const char *WIFI_STATE_NAMES[] = {"idle", "connecting", "connected", "backoff", "ap"};
+
+const char *wifiStateName(WiFiState state) {
+  return WIFI_STATE_NAMES[state];
+}
+
+static void setWiFiState(WiFiState state) {
+  wifiStats.state = state;
+  stateSinceMs = millis();
+}
+
+static void onWiFiEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
+  switch (event) {
+  case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+    memcpy(connectedBssid, info.wifi_sta_connected.bssid, sizeof(connectedBssid));
+    connectedChannel = info.wifi_sta_connected.channel;
+    break;
+  case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+    gotIpEvent = true;
+    break;
+  case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+    disconnectReason = info.wifi_sta_disconnected.reason;
+    disconnectAtMs = millis();
+    disconnectEvent = true;
+    break;
+  default:
+    break;
+  }
+}
+
+static void loadCachedAp() {
+  preferences.begin("wifi", true);
+  cachedChannel = preferences.getUChar("channel", 0);
+  if (preferences.getBytes("bssid", cachedBssid, sizeof(cachedBssid)) != sizeof(cachedBssid)) {
+    cachedChannel = 0;
+  }
+  preferences.end();
+  useCachedAp = cachedChannel != 0;
+}
+
+// Only write when the access point changed, to spare the flash
+static void saveCachedAp() {
+  if (connectedChannel == 0) return;
+  if (connectedChannel == cachedChannel && memcmp(connectedBssid, cachedBssid, sizeof(cachedBssid)) == 0) return;
+
+  memcpy(cachedBssid, connectedBssid, sizeof(cachedBssid));
+  cachedChannel = connectedChannel;
+  preferences.begin("wifi", false);
+  preferences.putBytes("bssid", cachedBssid, sizeof(cachedBssid));
+  preferences.putUChar("channel", cachedChannel);
+  preferences.end();
+}
+
+static void clearCachedAp() {
+  cachedChannel = 0;
+  useCachedAp = false;
+  preferences.begin("wifi", false);
+  preferences.remove("bssid");
+  preferences.remove("channel");
+  preferences.end();
+}
+
+static void startConnect() {
+  gotIpEvent = false;
+  disconnectEvent = false;
+  connectedChannel = 0;
+  if (useCachedAp) {
+    // Fast path: known channel and BSSID, no scan
+    WiFi.begin(ssid, password, cachedChannel, cachedBssid);
+  } else {
+    WiFi.begin(ssid, password);
+  }
+  setWiFiState(WIFI_STATE_CONNECTING);
+}
+
+static void connectFailed() {
+  wifiStats.failures++;
+  // A stale cached AP is the likeliest cause of a failed fast reconnect
+  useCachedAp = false;
+
+  if (wifiStats.failures >= wifiPolicy.apFallbackFailures) {
+    if (WiFi.getMode() != WIFI_AP_STA) {
+      SERIAL_PRINTLN("WiFi: " + String(wifiStats.failures) + " failed attempts, starting AP");
+      switchToAPMode();
+    } else {
+      setWiFiState(WIFI_STATE_AP);
+    }
+    return;
+  }
+
+  backoffMs = wifiPolicy.backoffMinMs << (wifiStats.failures - 1);
+  if (backoffMs > wifiPolicy.backoffMaxMs) backoffMs = wifiPolicy.backoffMaxMs;
+  backoffMs += random(backoffMs / 4 + 1); // Jitter
+  setWiFiState(WIFI_STATE_BACKOFF);
+}
+
 void initWiFi() {
   // Initialize LittleFS
   if (!LittleFS.begin(true)) {
@@ -18,55 +149,121 @@ void initWiFi() {
     return;
   }
   SERIAL_PRINTLN("LittleFS mounted successfully");
+  markBootPhase(BOOT_FS_MOUNTED);
 
   preferences.begin("wifi", false);
   preferences.getString("ssid", ssid, sizeof(ssid));
   preferences.getString("password", password, sizeof(password));
   preferences.end();
   
-  if (!ssid || !password) {
+  if (ssid[0] == 0) {
     //fall back to strings defined above
     strlcpy(ssid, "Slow_Network", sizeof(ssid));
     strlcpy(password, "W1F1_-Pa55!", sizeof(password));
   }
+  loadCachedAp();
 
-
-  WiFi.onEvent(onWiFiDisconnected, WiFiEvent_t::ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+  // The state machine owns reconnects; the SDK must not retry or write flash behind it
+  WiFi.persistent(false);
+  WiFi.setAutoReconnect(false);
+  WiFi.onEvent(onWiFiEvent, ARDUINO_EVENT_WIFI_STA_CONNECTED);
+  WiFi.onEvent(onWiFiEvent, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+  WiFi.onEvent(onWiFiEvent, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
 
   WiFi.mode(WIFI_STA);
-  WiFi.begin(ssid, password);
-  SERIAL_PRINT("Connecting to WiFi ..");
-
-  int timeout = 0;
-  while (WiFi.status() != WL_CONNECTED && timeout < 20) {
-    SERIAL_PRINT('.');
-    delay(500);
-    timeout++;
-  }
+  initWebServerWithWebSocket();  // Listens on every interface, before or after the link is up
+  markBootPhase(BOOT_SERVER_STARTED);
 
-  if (WiFi.status() == WL_CONNECTED) {
-    SERIAL_PRINTLN("\nConnected to WiFi!");
-    SERIAL_PRINT("IP Address: ");
-    SERIAL_PRINTLN(WiFi.localIP());
-    initWebServerWithWebSocket();  // Initialize web server with WebSocket
-  } else {
-    SERIAL_PRINTLN("\nFailed to connect, switching to AP mode.");
-    switchToAPMode();
-  }
+  SERIAL_PRINTLN("Connecting to WiFi " + String(ssid) + (useCachedAp ? " (cached AP)" : ""));
+  startConnect();
 }
 
+// Keep the AP running and retry the station in the background
 void switchToAPMode() {
-  WiFi.mode(WIFI_AP);
+  WiFi.mode(WIFI_AP_STA);
   WiFi.softAP(ap_ssid, ap_password);
   IPAddress apIP = WiFi.softAPIP();
   SERIAL_PRINT("AP IP Address: ");
   SERIAL_PRINTLN(apIP.toString());
-  initWebServerWithWebSocket();  // Initialize web server with WebSocket
-  SERIAL_PRINTLN("HTTP server started on port 80");
-  
+  setWiFiState(WIFI_STATE_AP);
+  markBootPhase(BOOT_NETWORK_UP);
+}
+
+// New credentials: drop the cached AP and reconnect from the state machine
+void requestWiFiReconnect() {
+  reconnectRequested = true;
+}
+
+// Called periodically from the scheduler; never blocks
+void updateWiFi() {
+  uint32_t now = millis();
+
+  updateScan();
+
+  if (reconnectRequested) {
+    reconnectRequested = false;
+    clearCachedAp();
+    wifiStats.failures = 0;
+    WiFi.disconnect();
+    SERIAL_PRINTLN("Connecting to WiFi " + String(ssid));
+    startConnect();
+    return;
+  }
+
+  switch (wifiStats.state) {
+  case WIFI_STATE_IDLE:
+    break;
+
+  case WIFI_STATE_CONNECTING:
+    if (gotIpEvent) {
+      gotIpEvent = false;
+      disconnectEvent = false;
+      wifiStats.failures = 0;
+      wifiStats.lastConnectMs = now - stateSinceMs;
+      saveCachedAp();
+      if (WiFi.getMode() == WIFI_AP_STA && WiFi.softAPgetStationNum() == 0) {
+        WiFi.softAPdisconnect(true);
+        WiFi.mode(WIFI_STA);
+      }
+      setWiFiState(WIFI_STATE_CONNECTED);
+      markBootPhase(BOOT_NETWORK_UP);
+      SERIAL_PRINTLN("Connected to WiFi, IP: " + WiFi.localIP().toString() + " in " + String(wifiStats.lastConnectMs) + " ms");
+    } else if (disconnectEvent && disconnectAtMs - stateSinceMs >= WIFI_EVENT_GRACE_MS) {
+      disconnectEvent = false;
+      SERIAL_PRINTLN("WiFi connect failed, reason " + String(disconnectReason));
+      connectFailed();
+    } else if (now - stateSinceMs >= wifiPolicy.connectTimeoutMs) {
+      SERIAL_PRINTLN("WiFi connect timed out");
+      connectFailed();
+    }
+    break;
+
+  case WIFI_STATE_CONNECTED:
+    if (disconnectEvent) {
+      disconnectEvent = false;
+      wifiStats.reconnects++;
+      SERIAL_PRINTLN("Wi-Fi disconnected, reason " + String(disconnectReason));
+      // Retry straight away on the cached AP; backoff only starts if that fails
+      useCachedAp = cachedChannel != 0;
+      startConnect();
+    }
+    break;
+
+  case WIFI_STATE_BACKOFF:
+    if (now - stateSinceMs >= backoffMs) {
+      startConnect();
+    }
+    break;
+
+  case WIFI_STATE_AP:
+    // Scanning for the station hops channels and disturbs AP clients, so only retry when nobody is attached
+    if (now - stateSinceMs >= wifiPolicy.apRetryMs && WiFi.softAPgetStationNum() == 0) {
+      startConnect();
+    }
+    break;
+  }
 }
 
-void onWiFiDisconnected(WiFiEvent_t event, WiFiEventInfo_t info) {
-  SERIAL_PRINTLN("Wi-Fi disconnected!");
-  switchToAPMode();
+WiFiState getWiFiState() {
+  return wifiStats.state;
 }
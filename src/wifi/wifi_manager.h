@@ -23,6 +23,33 @@ void addToSerialBuffer(String message);
 // Helper macros for complex expressions
 #define SERIAL_PRINTLN_STR(x) SERIAL_PRINTLN(String(x))
 
+// Connection manager states
+enum WiFiState {
+  WIFI_STATE_IDLE,
+  WIFI_STATE_CONNECTING,
+  WIFI_STATE_CONNECTED,
+  WIFI_STATE_BACKOFF,   // Waiting before the next attempt
+  WIFI_STATE_AP         // Fallback AP up, station retried in the background
+};
+
+struct WiFiPolicy {
+  uint32_t connectTimeoutMs;
+  uint32_t backoffMinMs;
+  uint32_t backoffMaxMs;
+  uint32_t apFallbackFailures;  // Consecutive failures before the AP starts
+  uint32_t apRetryMs;           // Station retry interval while in AP mode
+};
+
+struct WiFiStats {
+  WiFiState state;
+  uint32_t failures;       // Consecutive failed attempts
+  uint32_t reconnects;     // Links lost after being connected
+  uint32_t lastConnectMs;  // Duration of the last successful attempt
+};
+
+extern WiFiPolicy wifiPolicy;
+extern WiFiStats wifiStats;
+
 extern char ssid[32];
 extern char password[64];
 extern const char* ap_ssid;
@@ -30,13 +57,22 @@ extern const char* ap_password;
 extern Preferences preferences;
 extern AsyncWebServer server;
 extern AsyncWebSocket ws;
-extern String scannedNetworks;
 
 void initWiFi();
+void updateWiFi();
+void requestWiFiReconnect();
+WiFiState getWiFiState();
+const char *wifiStateName(WiFiState state);
 void switchToAPMode();
-void onWiFiDisconnected(WiFiEvent_t event, WiFiEventInfo_t info);
 void initWebServerWithWebSocket();
-void scanNetworks();
-void sendAngleData(float angle, float target);
+void broadcastText(const char *text, size_t len);
+void sendAngleData(float angle, float target, float commanded, uint32_t sampleUs);
+void sendPIDValues();
+void sendPIDTerms(float pTerm, float iTerm, float dTerm, float output);
+void sendStreamMetrics();
+void sendTargetAngle();
+void sendStatusUpdates();
+void sendConsoleBuffer();
+void toggleLed();
 
 #endif
@@ -0,0 +1,140 @@
+#include "wifi_scan.h"
+#include "wifi_manager.h"
+#include "json_format.h"
+
+// Results younger than this are served without rescanning
+const uint32_t SCAN_MIN_INTERVAL_MS = 10000;
+
+static ScanResult scanResults[MAX_SCAN_RESULTS];
+static int scanCount = 0;
+static uint32_t scanUpdatedMs = 0;
+static bool scanValid = false;
+
+static volatile bool scanRequested = false;
+static volatile bool scanRunning = false;
+
+// Results are written by the scheduler task and read by the web server task
+static portMUX_TYPE scanMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Formatted results for WebSocket notifications (scheduler task only)
+static char scanNotice[SCAN_JSON_SIZE];
+
+void requestScan()
+{
+  if (scanRunning)
+    return;
+  if (scanValid && millis() - scanUpdatedMs < SCAN_MIN_INTERVAL_MS)
+    return;
+  scanRequested = true;
+}
+
+bool scanInProgress()
+{
+  return scanRunning || scanRequested;
+}
+
+static void storeScanResults(int n)
+{
+  if (n > MAX_SCAN_RESULTS)
+    n = MAX_SCAN_RESULTS; // The driver reports the strongest networks first
+
+  // The driver calls allocate, so they run unlocked; the lock only covers the copy
+  static ScanResult fresh[MAX_SCAN_RESULTS];
+  for (int i = 0; i < n; i++)
+  {
+    strlcpy(fresh[i].ssid, WiFi.SSID(i).c_str(), sizeof(fresh[i].ssid));
+    fresh[i].rssi = WiFi.RSSI(i);
+    fresh[i].channel = WiFi.channel(i);
+    fresh[i].auth = WiFi.encryptionType(i);
+  }
+
+  portENTER_CRITICAL(&scanMux);
+  memcpy(scanResults, fresh, n * sizeof(ScanResult));
+  scanCount = n;
+  scanUpdatedMs = millis();
+  scanValid = true;
+  portEXIT_CRITICAL(&scanMux);
+}
+
+void updateScan()
+{
+  if (scanRequested && !scanRunning)
+  {
+    // A scan would stall an association in progress, wait for it to settle
+    if (getWiFiState() == WIFI_STATE_CONNECTING)
+      return;
+
+    scanRequested = false;
+    if (WiFi.scanNetworks(true) == WIFI_SCAN_FAILED)
+    {
+      SERIAL_PRINTLN("WiFi scan failed to start");
+      return;
+    }
+    scanRunning = true;
+    return;
+  }
+
+  if (!scanRunning)
+    return;
+
+  int16_t n = WiFi.scanComplete();
+  if (n == WIFI_SCAN_RUNNING)
+    return;
+
+  scanRunning = false;
+  if (n >= 0)
+  {
+    storeScanResults(n);
+    SERIAL_PRINTLN("Scan complete. Found " + String(n) + " networks.");
+  }
+  else
+  {
+    SERIAL_PRINTLN("WiFi scan failed");
+  }
+  WiFi.scanDelete();
+
+  size_t len = formatScanJson(scanNotice, sizeof(scanNotice));
+  broadcastText(scanNotice, len);
+}
+
+size_t formatScanJson(char *buf, size_t size)
+{
+  ScanResult results[MAX_SCAN_RESULTS];
+  int count;
+  uint32_t updatedMs;
+  bool valid;
+
+  portENTER_CRITICAL(&scanMux);
+  memcpy(results, scanResults, sizeof(results));
+  count = scanCount;
+  updatedMs = scanUpdatedMs;
+  valid = scanValid;
+  portEXIT_CRITICAL(&scanMux);
+
+  // Room to close the array and object
+  const size_t closing = 3;
+  size -= closing;
+
+  size_t len = 0;
+  appendJson(buf, size, len, "{\"type\":\"scan-results\",\"scanning\":%s,\"age\":%ld,\"networks\":[",
+             scanInProgress() ? "true" : "false", valid ? (long)(millis() - updatedMs) : -1L);
+
+  for (int i = 0; i < count; i++)
+  {
+    size_t start = len;
+    bool ok = appendJson(buf, size, len, "%s{\"ssid\":", i > 0 ? "," : "") &&
+              appendJsonString(buf, size, len, results[i].ssid) &&
+              appendJson(buf, size, len, ",\"rssi\":%d,\"channel\":%u,\"encryption\":\"%s\"}",
+                         results[i].rssi, results[i].channel,
+                         results[i].auth == WIFI_AUTH_OPEN ? "Open" : "Secured");
+    if (!ok)
+    {
+      len = start;
+      break;
+    }
+  }
+
+  size += closing;
+  len += snprintf(buf + len, size - len, "]}");
+  return len;
+}
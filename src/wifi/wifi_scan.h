@@ -0,0 +1,30 @@
+#ifndef WIFI_SCAN_H
+#define WIFI_SCAN_H
+
+#include <Arduino.h>
+
+const int MAX_SCAN_RESULTS = 16;
+const size_t SCAN_JSON_SIZE = 2048;
+
+struct ScanResult
+{
+  char ssid[33];
+  int8_t rssi;
+  uint8_t channel;
+  uint8_t auth; // wifi_auth_mode_t
+};
+
+// Start a background scan unless one is running or the cache is still fresh.
+// Safe to call from the web server task.
+void requestScan();
+
+// Poll the driver and publish finished scans; called from the WiFi scheduler task
+void updateScan();
+
+bool scanInProgress();
+
+// Cached results as {"type":"scan-results","scanning":..,"age":..,"networks":[..]}.
+// Returns the length, networks that do not fit in size are left out.
+size_t formatScanJson(char *buf, size_t size);
+
+#endif
@@ -0,0 +1,234 @@
+#include "ws_streams.h"
+#include "wifi_manager.h"
+
+const uint32_t STREAM_ADAPT_INTERVAL_MS = 500;
+
+const char *const STREAM_NAMES[] = {"tilt", "pid", "console", "metrics", "latency", NULL};
+
+struct StreamFrame
+{
+    uint16_t len;
+    char data[STREAM_FRAME_SIZE];
+};
+
+struct StreamClient
+{
+    bool active;
+    uint32_t id;
+    uint32_t subscriptions;
+    uint32_t periodMs[STREAM_COUNT];
+    uint32_t lastQueuedMs[STREAM_COUNT];
+    uint8_t decimation;
+    uint8_t skipped[STREAM_COUNT];
+    uint32_t lastAdaptMs;
+
+    // Bounded ring of frames waiting for the client's TCP queue
+    StreamFrame frames[STREAM_QUEUE_DEPTH];
+    uint8_t head;
+    uint8_t count;
+    uint8_t maxCount;
+
+    uint32_t sent;
+    uint32_t dropped;
+};
+
+static StreamClient clients[MAX_STREAM_CLIENTS];
+
+// Clients are added/removed on the AsyncTCP task and served from the control loop task
+static portMUX_TYPE streamsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static StreamClient *findClient(uint32_t id)
+{
+    for (int i = 0; i < MAX_STREAM_CLIENTS; i++)
+    {
+        if (clients[i].active && clients[i].id == id)
+            return &clients[i];
+    }
+    return NULL;
+}
+
+void addStreamClient(uint32_t id)
+{
+    portENTER_CRITICAL(&streamsMux);
+    for (int i = 0; i < MAX_STREAM_CLIENTS; i++)
+    {
+        if (!clients[i].active)
+        {
+            StreamClient &client = clients[i];
+            memset(&client, 0, sizeof(client));
+            client.active = true;
+            client.id = id;
+            client.decimation = 1;
+
+            // Dashboard defaults: tilt at 10 Hz plus the console
+            client.subscriptions = (1 << STREAM_TILT) | (1 << STREAM_CONSOLE);
+            client.periodMs[STREAM_TILT] = 100;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&streamsMux);
+}
+
+void removeStreamClient(uint32_t id)
+{
+    portENTER_CRITICAL(&streamsMux);
+    StreamClient *client = findClient(id);
+    if (client != NULL)
+        client->active = false;
+    portEXIT_CRITICAL(&streamsMux);
+}
+
+void subscribeStream(uint32_t id, StreamId stream, float rateHz)
+{
+    portENTER_CRITICAL(&streamsMux);
+    StreamClient *client = findClient(id);
+    if (client != NULL)
+    {
+        if (rateHz <= 0)
+        {
+            client->subscriptions &= ~(1 << stream);
+        }
+        else
+        {
+            client->subscriptions |= (1 << stream);
+            client->periodMs[stream] = 1000.0 / rateHz;
+        }
+    }
+    portEXIT_CRITICAL(&streamsMux);
+}
+
+bool streamHasSubscribers(StreamId stream)
+{
+    for (int i = 0; i < MAX_STREAM_CLIENTS; i++)
+    {
+        if (clients[i].active && (clients[i].subscriptions & (1 << stream)))
+            return true;
+    }
+    return false;
+}
+
+// Queue a frame for every subscriber that is due, dropping its oldest frame if full
+void publishStream(StreamId stream, const char *data, size_t len)
+{
+    // Console lines are plain text and are cut short; truncating would break
+    // the JSON of the other streams, so oversized frames are not queued
+    bool truncated = len > STREAM_FRAME_SIZE;
+    if (truncated)
+    {
+        if (stream != STREAM_CONSOLE)
+            return;
+        len = STREAM_FRAME_SIZE;
+    }
+
+    uint32_t now = millis();
+    portENTER_CRITICAL(&streamsMux);
+    for (int i = 0; i < MAX_STREAM_CLIENTS; i++)
+    {
+        StreamClient &client = clients[i];
+        if (!client.active || !(client.subscriptions & (1 << stream)))
+            continue;
+
+        if (stream != STREAM_CONSOLE)
+        {
+            if (now - client.lastQueuedMs[stream] < client.periodMs[stream])
+                continue;
+            client.lastQueuedMs[stream] = now;
+
+            // Behind: only queue every Nth due frame
+            if (++client.skipped[stream] < client.decimation)
+                continue;
+            client.skipped[stream] = 0;
+        }
+
+        if (client.count == STREAM_QUEUE_DEPTH)
+        {
+            client.head = (client.head + 1) % STREAM_QUEUE_DEPTH;
+            client.count--;
+            client.dropped++;
+        }
+        StreamFrame &frame = client.frames[(client.head + client.count) % STREAM_QUEUE_DEPTH];
+        memcpy(frame.data, data, len);
+        if (truncated)
+            frame.data[len - 1] = '\n';
+        frame.len = len;
+        client.count++;
+        if (client.count > client.maxCount)
+            client.maxCount = client.count;
+    }
+    portEXIT_CRITICAL(&streamsMux);
+}
+
+// Hand queued frames to each client's TCP queue while it has room, and adapt
+// decimation to how far behind the client is
+void pumpStreams()
+{
+    static StreamFrame frame;
+
+    for (int i = 0; i < MAX_STREAM_CLIENTS; i++)
+    {
+        StreamClient &client = clients[i];
+        if (!client.active)
+            continue;
+
+        // The AsyncTCP task may free a client at any time, so it is only ever
+        // looked up by id inside the library, never held across calls
+        if (!ws.hasClient(client.id))
+        {
+            removeStreamClient(client.id);
+            continue;
+        }
+
+        while (ws.availableForWrite(client.id))
+        {
+            portENTER_CRITICAL(&streamsMux);
+            bool hasFrame = client.active && client.count > 0;
+            if (hasFrame)
+            {
+                frame = client.frames[client.head];
+                client.head = (client.head + 1) % STREAM_QUEUE_DEPTH;
+                client.count--;
+            }
+            portEXIT_CRITICAL(&streamsMux);
+
+            if (!hasFrame)
+                break;
+            if (!ws.text(client.id, frame.data, frame.len))
+            {
+                client.dropped++; // Disconnected since the check, removed next pass
+                break;
+            }
+            client.sent++;
+        }
+
+        // More than half full after draining: back off; empty: speed up again
+        uint32_t now = millis();
+        if (now - client.lastAdaptMs < STREAM_ADAPT_INTERVAL_MS)
+            continue;
+        client.lastAdaptMs = now;
+        if (client.count > STREAM_QUEUE_DEPTH / 2 && client.decimation < MAX_STREAM_DECIMATION)
+            client.decimation++;
+        else if (client.count == 0 && client.decimation > 1)
+            client.decimation--;
+    }
+}
+
+int getStreamClientStats(StreamClientStats *stats, int maxClients)
+{
+    int n = 0;
+    portENTER_CRITICAL(&streamsMux);
+    for (int i = 0; i < MAX_STREAM_CLIENTS && n < maxClients; i++)
+    {
+        if (!clients[i].active)
+            continue;
+        stats[n].id = clients[i].id;
+        stats[n].subscriptions = clients[i].subscriptions;
+        stats[n].queueDepth = clients[i].count;
+        stats[n].maxQueueDepth = clients[i].maxCount;
+        stats[n].decimation = clients[i].decimation;
+        stats[n].sent = clients[i].sent;
+        stats[n].dropped = clients[i].dropped;
+        n++;
+    }
+    portEXIT_CRITICAL(&streamsMux);
+    return n;
+}
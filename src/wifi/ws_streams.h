@@ -0,0 +1,43 @@
+#ifndef WS_STREAMS_H
+#define WS_STREAMS_H
+
+#include <Arduino.h>
+
+// Named telemetry streams WebSocket clients can subscribe to
+enum StreamId {
+    STREAM_TILT,    // Angle and setpoint
+    STREAM_PID,     // P/I/D terms and output
+    STREAM_CONSOLE, // Serial console lines (not rate limited, only queue limited)
+    STREAM_METRICS, // Queue, scheduler and command statistics
+    STREAM_LATENCY, // Command latency percentiles
+    STREAM_COUNT
+};
+
+const int MAX_STREAM_CLIENTS = 4;
+const int STREAM_QUEUE_DEPTH = 8;
+const int STREAM_FRAME_SIZE = 320;
+const int MAX_STREAM_DECIMATION = 8;
+
+// Per-client delivery statistics
+struct StreamClientStats {
+    uint32_t id;
+    uint32_t subscriptions; // Bit per StreamId
+    uint8_t queueDepth;
+    uint8_t maxQueueDepth;
+    uint8_t decimation;     // Only every Nth due frame is queued when the client falls behind
+    uint32_t sent;
+    uint32_t dropped;       // Frames dropped from a full queue (oldest first)
+};
+
+extern const char *const STREAM_NAMES[];
+
+void addStreamClient(uint32_t id);
+void removeStreamClient(uint32_t id);
+void subscribeStream(uint32_t id, StreamId stream, float rateHz); // rateHz 0 unsubscribes
+void publishStream(StreamId stream, const char *data, size_t len);
+bool streamHasSubscribers(StreamId stream);
+void pumpStreams(); // Drain client queues, call periodically from the control loop task
+
+int getStreamClientStats(StreamClientStats *stats, int maxClients);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+// Host stand-in for the few Arduino APIs used by the hardware-free modules,
+// so the native test environment can build them unchanged. The clock only
+// moves when a test calls setNativeMicros().
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+// As in the ESP32 Arduino core: std overloads rather than macros, so float
+// arguments keep their type and library headers are not rewritten
+using std::abs;
+using std::isinf;
+using std::isnan;
+using std::max;
+using std::min;
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+inline unsigned long &nativeMicros()
+{
+    static unsigned long us = 0;
+    return us;
+}
+
+inline void setNativeMicros(unsigned long us)
+{
+    nativeMicros() = us;
+}
+
+inline unsigned long micros()
+{
+    return nativeMicros();
+}
+
+inline unsigned long millis()
+{
+    return nativeMicros() / 1000;
+}
+
+struct NativeSerial
+{
+    int printf(const char *format, ...)
+    {
+        va_list args;
+        va_start(args, format);
+        int n = vprintf(format, args);
+        va_end(args);
+        return n;
+    }
+    void println(const char *text)
+    {
+        puts(text);
+    }
+};
+
+static NativeSerial Serial __attribute__((unused));
+
+#endif
@@ -0,0 +1,168 @@
+// Shared command schema and transport parsers (control/commands)
+
+#include <unity.h>
+
+// Built here rather than through build_src_filter: it links against the
+// choice tables and the queue, which live with modules that need the hardware
+// and are stood in for below, only for this suite
+#include "control/commands.cpp"
+
+const char *const STREAM_NAMES[] = {"tilt", "pid", "console", "metrics", "latency", NULL};
+const char *const CAPTURE_ACTION_NAMES[] = {"arm", "trigger", "stop", NULL};
+const char *const STEP_TEST_KIND_NAMES[] = {"step", "impulse", "abort", NULL};
+
+static int postedCount = 0;
+static bool queueFull = false;
+
+bool postCommand(ControlCommand &cmd)
+{
+    if (queueFull)
+        return false;
+    postedCount++;
+    return true;
+}
+
+static ControlCommand cmd;
+
+void setUp()
+{
+    memset(&cmd, 0, sizeof(cmd));
+    postedCount = 0;
+    queueFull = false;
+}
+
+void tearDown()
+{
+}
+
+void test_every_command_name_resolves()
+{
+    for (int i = 0; i < CMD_COUNT; i++)
+    {
+        const CommandSpec &spec = commandSpec((CommandType)i);
+        TEST_ASSERT_EQUAL_INT(i, spec.type);
+        TEST_ASSERT_EQUAL_INT(CMD_OK, parseCommandName(spec.name, SRC_WS, cmd));
+        TEST_ASSERT_EQUAL_INT(i, cmd.type);
+        TEST_ASSERT_EQUAL_INT(SRC_WS, cmd.source);
+    }
+}
+
+void test_unknown_names_are_rejected()
+{
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_UNKNOWN, parseCommandName("launch", SRC_HTTP, cmd));
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_UNKNOWN, parseCommandName("", SRC_HTTP, cmd));
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_UNKNOWN, parseCommandName("spee", SRC_HTTP, cmd));
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_UNKNOWN, parseCommandName(NULL, SRC_HTTP, cmd));
+}
+
+void test_parse_clears_previous_arguments()
+{
+    cmd.args[0] = 5;
+    cmd.args[2] = 7;
+    cmd.enqueuedAt = 99;
+    TEST_ASSERT_EQUAL_INT(CMD_OK, parseCommandName("stop", SRC_SERIAL, cmd));
+    TEST_ASSERT_EQUAL_FLOAT(0, cmd.args[0]);
+    TEST_ASSERT_EQUAL_FLOAT(0, cmd.args[2]);
+    TEST_ASSERT_EQUAL_UINT32(0, cmd.enqueuedAt);
+}
+
+void test_numeric_arguments_are_range_checked()
+{
+    parseCommandName("set-pid", SRC_HTTP, cmd);
+    TEST_ASSERT_EQUAL_INT(CMD_OK, setCommandArg(cmd, 0, 500));
+    TEST_ASSERT_EQUAL_FLOAT(500, cmd.args[0]);
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_OUT_OF_RANGE, setCommandArg(cmd, 0, 500.5));
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_OUT_OF_RANGE, setCommandArg(cmd, 1, -1));
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_BAD_ARG, setCommandArg(cmd, 2, NAN));
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_BAD_ARG, setCommandArg(cmd, 2, INFINITY));
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_BAD_ARG, setCommandArg(cmd, 3, 1));
+    // Rejected values leave the argument untouched
+    TEST_ASSERT_EQUAL_FLOAT(0, cmd.args[1]);
+}
+
+void test_text_arguments()
+{
+    parseCommandName("speed", SRC_HTTP, cmd);
+    TEST_ASSERT_EQUAL_INT(CMD_OK, setCommandArgText(cmd, 0, "42.5"));
+    TEST_ASSERT_EQUAL_FLOAT(42.5, cmd.args[0]);
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_BAD_ARG, setCommandArgText(cmd, 0, "42x"));
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_BAD_ARG, setCommandArgText(cmd, 0, "fast"));
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_MISSING_ARG, setCommandArgText(cmd, 0, ""));
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_MISSING_ARG, setCommandArgText(cmd, 0, NULL));
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_OUT_OF_RANGE, setCommandArgText(cmd, 0, "101"));
+}
+
+void test_choice_arguments_map_to_enum_values()
+{
+    parseCommandName("subscribe", SRC_WS, cmd);
+    TEST_ASSERT_EQUAL_INT(CMD_OK, setCommandArgText(cmd, 0, "metrics"));
+    TEST_ASSERT_EQUAL_FLOAT(STREAM_METRICS, cmd.args[0]);
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_BAD_ARG, setCommandArgText(cmd, 0, "video"));
+
+    parseCommandName("adjust-pid", SRC_WS, cmd);
+    TEST_ASSERT_EQUAL_INT(CMD_OK, setCommandArgText(cmd, 0, "base-speed"));
+    TEST_ASSERT_EQUAL_FLOAT(PID_BASE_SPEED, cmd.args[0]);
+
+    parseCommandName("step-test", SRC_WS, cmd);
+    TEST_ASSERT_EQUAL_INT(CMD_OK, setCommandArgText(cmd, 0, "impulse"));
+    TEST_ASSERT_EQUAL_FLOAT(STEP_IMPULSE, cmd.args[0]);
+}
+
+void test_serial_keys()
+{
+    TEST_ASSERT_EQUAL_INT(CMD_OK, parseSerialKey('v', cmd));
+    TEST_ASSERT_EQUAL_INT(CMD_ADJUST_TARGET, cmd.type);
+    TEST_ASSERT_EQUAL_INT(SRC_SERIAL, cmd.source);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.1, cmd.args[0]);
+
+    TEST_ASSERT_EQUAL_INT(CMD_OK, parseSerialKey('h', cmd));
+    TEST_ASSERT_EQUAL_INT(CMD_ADJUST_PID, cmd.type);
+    TEST_ASSERT_EQUAL_FLOAT(PID_KD, cmd.args[0]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, -0.001, cmd.args[1]);
+
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_UNKNOWN, parseSerialKey('?', cmd));
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_UNKNOWN, parseSerialKey((char)0xF6, cmd));
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_UNKNOWN, parseSerialKey('V', cmd));
+}
+
+void test_text_commands()
+{
+    TEST_ASSERT_EQUAL_INT(CMD_OK, parseTextCommand("forward", NULL, SRC_HTTP, cmd));
+    TEST_ASSERT_EQUAL_INT(CMD_FORWARD, cmd.type);
+
+    TEST_ASSERT_EQUAL_INT(CMD_OK, parseTextCommand("adjust-target-angle", "-2.5", SRC_HTTP, cmd));
+    TEST_ASSERT_EQUAL_FLOAT(-2.5, cmd.args[0]);
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_MISSING_ARG, parseTextCommand("adjust-target-angle", NULL, SRC_HTTP, cmd));
+
+    // Several arguments cannot be carried by a single value
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_MISSING_ARG, parseTextCommand("set-pid", "1", SRC_HTTP, cmd));
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_UNKNOWN, parseTextCommand("fly", "1", SRC_HTTP, cmd));
+}
+
+void test_submit_reports_a_full_queue()
+{
+    parseCommandName("stop", SRC_WS, cmd);
+    TEST_ASSERT_EQUAL_INT(CMD_OK, submitCommand(cmd));
+    TEST_ASSERT_EQUAL_INT(1, postedCount);
+
+    queueFull = true;
+    TEST_ASSERT_EQUAL_INT(CMD_ERR_QUEUE_FULL, submitCommand(cmd));
+    TEST_ASSERT_EQUAL_STRING("command queue full", commandErrorString(CMD_ERR_QUEUE_FULL));
+}
+
+int main(int argc, char **argv)
+{
+    initCommands();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_every_command_name_resolves);
+    RUN_TEST(test_unknown_names_are_rejected);
+    RUN_TEST(test_parse_clears_previous_arguments);
+    RUN_TEST(test_numeric_arguments_are_range_checked);
+    RUN_TEST(test_text_arguments);
+    RUN_TEST(test_choice_arguments_map_to_enum_values);
+    RUN_TEST(test_serial_keys);
+    RUN_TEST(test_text_commands);
+    RUN_TEST(test_submit_reports_a_full_queue);
+    return UNITY_END();
+}
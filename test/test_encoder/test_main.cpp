@@ -0,0 +1,99 @@
+// Fake encoder (ENCODER_FAKE) and the odometry built on it. The encoder state
+// is static, so the tests run in order and each one continues from the last.
+
+#include <unity.h>
+#include "encoder/encoder.h"
+
+const float MM_PER_COUNT = PI * WHEEL_DIAMETER_MM / ENCODER_COUNTS_PER_REV;
+
+static unsigned long nowUs = 0;
+
+// One 20 ms drive tick at the given duties
+static void tick(int leftDuty, int rightDuty)
+{
+    nowUs += 20000;
+    setNativeMicros(nowUs);
+    updateEncoders(leftDuty, rightDuty);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_idle_motors_do_not_count()
+{
+    initEncoders();
+    for (int i = 0; i < 50; i++)
+        tick(0, 0);
+
+    const WheelOdometry &odo = getOdometry();
+    TEST_ASSERT_EQUAL_INT32(0, odo.leftCount);
+    TEST_ASSERT_EQUAL_INT32(0, odo.rightCount);
+    TEST_ASSERT_FALSE(encodersDetected());
+}
+
+void test_detected_after_counting_while_driven()
+{
+    // 6000 counts/s at full duty: 10% for 20 ms is 12 counts per tick
+    for (int i = 0; i < 4; i++)
+        tick(10, 10);
+    TEST_ASSERT_FALSE(encodersDetected());
+
+    // Only one wheel moving is not enough
+    for (int i = 0; i < 10; i++)
+        tick(10, 0);
+    TEST_ASSERT_FALSE(encodersDetected());
+
+    tick(10, 10);
+    TEST_ASSERT_TRUE(encodersDetected());
+}
+
+void test_duty_integrates_into_odometry()
+{
+    resetOdometry();
+    int32_t startLeft = getOdometry().leftCount;
+    int32_t startRight = getOdometry().rightCount;
+
+    // One second, left forward at 50%, right backward at 50%: a spin in place
+    for (int i = 0; i < 50; i++)
+        tick(50, -50);
+
+    const WheelOdometry &odo = getOdometry();
+    TEST_ASSERT_EQUAL_INT32(3000, odo.leftCount - startLeft);
+    TEST_ASSERT_EQUAL_INT32(-3000, odo.rightCount - startRight);
+    TEST_ASSERT_FLOAT_WITHIN(1.0, 0.0, odo.distance);
+    TEST_ASSERT_FLOAT_WITHIN(1.0, 0.0, odo.velocity);
+    TEST_ASSERT_FLOAT_WITHIN(5.0, 3000 * MM_PER_COUNT, odo.leftVelocity);
+    // Left wheel forward, right backward turns right (negative heading)
+    TEST_ASSERT_FLOAT_WITHIN(0.5, -6000 * MM_PER_COUNT / WHEEL_BASE_MM * 180.0 / PI, odo.heading);
+}
+
+void test_injected_counts_override_duty()
+{
+    resetOdometry();
+    const WheelOdometry &odo = getOdometry();
+
+    // One wheel revolution forward on both sides, whatever the duty says
+    setFakeEncoderCounts(odo.leftCount + ENCODER_COUNTS_PER_REV, odo.rightCount + ENCODER_COUNTS_PER_REV);
+    tick(-100, -100);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, PI * WHEEL_DIAMETER_MM, odo.distance);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 0.0, odo.heading);
+
+    // Counts held: no further motion
+    tick(-100, -100);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, PI * WHEEL_DIAMETER_MM, odo.distance);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_idle_motors_do_not_count);
+    RUN_TEST(test_detected_after_counting_while_driven);
+    RUN_TEST(test_duty_integrates_into_odometry);
+    RUN_TEST(test_injected_counts_override_duty);
+    return UNITY_END();
+}
@@ -0,0 +1,95 @@
+// Complementary-filter tilt estimator (gyro/estimator)
+
+#include <unity.h>
+#include <math.h>
+#include "gyro/estimator.h"
+
+// A still sample tilted by the given pitch (degrees), with an optional pitch rate
+static ImuSample sampleAt(uint32_t timeUs, float pitchDeg, float rateDps)
+{
+    float rad = pitchDeg * (float)M_PI / 180.0f;
+    ImuSample sample = {};
+    sample.timeUs = timeUs;
+    sample.accel[0] = (int16_t)lroundf(-sinf(rad) * ACCEL_COUNTS_PER_G);
+    sample.accel[2] = (int16_t)lroundf(cosf(rad) * ACCEL_COUNTS_PER_G);
+    // Firmware flips the Y gyro sign to match the accelerometer angle
+    sample.gyro[1] = (int16_t)lroundf(-rateDps * GYRO_COUNTS_PER_DPS);
+    return sample;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_accel_tilt_covers_full_circle()
+{
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 0.0, accelTiltAngle(sampleAt(0, 0.0, 0)));
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 87.0, accelTiltAngle(sampleAt(0, 87.0, 0)));
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 180.0, accelTiltAngle(sampleAt(0, 180.0, 0)));
+    // Negative pitch wraps into 0-360
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 300.0, accelTiltAngle(sampleAt(0, -60.0, 0)));
+}
+
+void test_reset_starts_from_accelerometer()
+{
+    AngleEstimator estimator;
+    resetAngleEstimator(estimator, sampleAt(1234, 80.0, 50.0));
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 80.0, estimator.angle);
+    TEST_ASSERT_EQUAL_UINT32(1234, estimator.lastTimeUs);
+}
+
+void test_still_robot_holds_angle()
+{
+    AngleEstimator estimator;
+    resetAngleEstimator(estimator, sampleAt(0, 87.0, 0));
+    for (uint32_t t = 5000; t <= 1000000; t += 5000)
+        updateAngleEstimator(estimator, sampleAt(t, 87.0, 0));
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 87.0, estimator.angle);
+}
+
+void test_converges_to_accelerometer_from_wrong_start()
+{
+    AngleEstimator estimator;
+    resetAngleEstimator(estimator, sampleAt(0, 70.0, 0));
+    float angle = 0;
+    for (uint32_t t = 5000; t <= 200000; t += 5000)
+        angle = updateAngleEstimator(estimator, sampleAt(t, 90.0, 0));
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 90.0, angle);
+}
+
+void test_gyro_rate_leads_accelerometer()
+{
+    // Gyro says 10 deg/s, accelerometer holds still: the steady-state lead is
+    // alpha / (1 - alpha) * rate * dt = 4 * 10 * 0.005 = 0.2 degrees
+    AngleEstimator estimator;
+    resetAngleEstimator(estimator, sampleAt(0, 87.0, 0));
+    for (uint32_t t = 5000; t <= 200000; t += 5000)
+        updateAngleEstimator(estimator, sampleAt(t, 87.0, 10.0));
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 87.2, estimator.angle);
+}
+
+void test_timer_wrap_keeps_dt_small()
+{
+    AngleEstimator estimator;
+    resetAngleEstimator(estimator, sampleAt(0xFFFFF000u, 87.0, 0));
+    // 0x1F00 us = 7.936 ms across the micros() wrap
+    updateAngleEstimator(estimator, sampleAt(0x00000F00u, 87.0, 100.0));
+    TEST_ASSERT_EQUAL_UINT32(0x00000F00u, estimator.lastTimeUs);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 87.0 + 0.8 * 100.0 * 0.007936, estimator.angle);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_accel_tilt_covers_full_circle);
+    RUN_TEST(test_reset_starts_from_accelerometer);
+    RUN_TEST(test_still_robot_holds_angle);
+    RUN_TEST(test_converges_to_accelerometer_from_wrong_start);
+    RUN_TEST(test_gyro_rate_leads_accelerometer);
+    RUN_TEST(test_timer_wrap_keeps_dt_small);
+    return UNITY_END();
+}
@@ -0,0 +1,110 @@
+// Bump allocator behind the command and config JSON documents (wifi/json_pool)
+
+#include <unity.h>
+#include "wifi/json_pool.h"
+
+static uint8_t pool[256] __attribute__((aligned(8)));
+
+void setUp()
+{
+    memset(pool, 0, sizeof(pool));
+}
+
+void tearDown()
+{
+}
+
+void test_allocations_are_aligned_and_disjoint()
+{
+    JsonPoolAllocator allocator(pool, sizeof(pool));
+    uint8_t *a = (uint8_t *)allocator.allocate(3);
+    uint8_t *b = (uint8_t *)allocator.allocate(5);
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_NOT_NULL(b);
+    TEST_ASSERT_EQUAL_INT(0, (uintptr_t)a % sizeof(void *));
+    TEST_ASSERT_EQUAL_INT(0, (uintptr_t)b % sizeof(void *));
+    TEST_ASSERT_TRUE(b >= a + 3);
+    TEST_ASSERT_TRUE(a >= pool && b + 5 <= pool + sizeof(pool));
+    TEST_ASSERT_EQUAL_INT(sizeof(pool), allocator.capacity());
+}
+
+void test_exhaustion_fails_without_overrun()
+{
+    JsonPoolAllocator allocator(pool, sizeof(pool));
+    TEST_ASSERT_NOT_NULL(allocator.allocate(200));
+    size_t used = allocator.used();
+    TEST_ASSERT_NULL(allocator.allocate(100));
+    TEST_ASSERT_EQUAL_UINT32(1, allocator.failures());
+    TEST_ASSERT_EQUAL_INT(used, allocator.used());
+}
+
+void test_reset_reclaims_the_pool()
+{
+    JsonPoolAllocator allocator(pool, sizeof(pool));
+    void *first = allocator.allocate(100);
+    allocator.deallocate(first);
+    TEST_ASSERT_TRUE(allocator.used() > 100);
+
+    allocator.reset();
+    TEST_ASSERT_EQUAL_INT(0, allocator.used());
+    TEST_ASSERT_EQUAL_PTR(first, allocator.allocate(100));
+}
+
+void test_last_block_grows_and_shrinks_in_place()
+{
+    JsonPoolAllocator allocator(pool, sizeof(pool));
+    allocator.allocate(8);
+    char *last = (char *)allocator.allocate(4);
+    memcpy(last, "abc", 4);
+    size_t before = allocator.used();
+
+    TEST_ASSERT_EQUAL_PTR(last, allocator.reallocate(last, 64));
+    TEST_ASSERT_EQUAL_STRING("abc", last);
+    TEST_ASSERT_EQUAL_PTR(last, allocator.reallocate(last, 4));
+    TEST_ASSERT_EQUAL_INT(before, allocator.used());
+
+    // Growing past the end of the pool fails and leaves the block alone
+    TEST_ASSERT_NULL(allocator.reallocate(last, sizeof(pool)));
+    TEST_ASSERT_EQUAL_INT(before, allocator.used());
+    TEST_ASSERT_EQUAL_STRING("abc", last);
+
+    // The grown block is really reserved: the next one starts after it
+    allocator.reallocate(last, 64);
+    char *next = (char *)allocator.allocate(1);
+    TEST_ASSERT_TRUE(next >= last + 64);
+}
+
+void test_older_block_is_copied_when_grown()
+{
+    JsonPoolAllocator allocator(pool, sizeof(pool));
+    char *older = (char *)allocator.allocate(6);
+    memcpy(older, "hello", 6);
+    allocator.allocate(8);
+
+    // Shrinking an older block keeps it where it is
+    TEST_ASSERT_EQUAL_PTR(older, allocator.reallocate(older, 6));
+
+    char *moved = (char *)allocator.reallocate(older, 32);
+    TEST_ASSERT_NOT_NULL(moved);
+    TEST_ASSERT_TRUE(moved != older);
+    TEST_ASSERT_EQUAL_STRING("hello", moved);
+}
+
+void test_reallocate_null_allocates()
+{
+    JsonPoolAllocator allocator(pool, sizeof(pool));
+    TEST_ASSERT_NOT_NULL(allocator.reallocate(NULL, 16));
+    TEST_ASSERT_TRUE(allocator.used() >= 16);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_allocations_are_aligned_and_disjoint);
+    RUN_TEST(test_exhaustion_fails_without_overrun);
+    RUN_TEST(test_reset_reclaims_the_pool);
+    RUN_TEST(test_last_block_grows_and_shrinks_in_place);
+    RUN_TEST(test_older_block_is_copied_when_grown);
+    RUN_TEST(test_reallocate_null_allocates);
+    return UNITY_END();
+}
@@ -0,0 +1,167 @@
+// Step-response metrics against synthetic responses (self_balancing/step_metrics)
+
+#include <unity.h>
+#include <math.h>
+#include "self_balancing/step_metrics.h"
+
+const int PRE = 50;
+const int RUN = 1000;
+const uint32_t TICK_US = 5000; // 200 Hz
+const float BASE = 87.0;
+
+static StepPoint points[PRE + RUN];
+
+// Baseline at BASE, then response(t) from the step on, with the setpoint at BASE + offset
+static void record(float (*response)(float t), float offset)
+{
+    for (int i = 0; i < PRE + RUN; i++)
+    {
+        float t = (i - PRE) * TICK_US / 1000000.0f;
+        points[i].timeUs = 1000000 + i * TICK_US;
+        points[i].angle = i < PRE ? BASE : BASE + response(t);
+        points[i].setpoint = BASE + (i < PRE ? 0 : offset);
+    }
+}
+
+// First order, tau = 0.1 s, towards +2 degrees
+static float firstOrder(float t)
+{
+    return 2.0f * (1 - expf(-t / 0.1f));
+}
+
+// Second order, zeta = 0.5, wn = 20 rad/s: 16.3% overshoot
+static float underdamped(float t)
+{
+    float zeta = 0.5f, wn = 20.0f;
+    float wd = wn * sqrtf(1 - zeta * zeta);
+    return 2.0f * (1 - expf(-zeta * wn * t) * (cosf(wd * t) + zeta / sqrtf(1 - zeta * zeta) * sinf(wd * t)));
+}
+
+// Settles short of the target
+static float offsetResponse(float t)
+{
+    return 1.5f * (1 - expf(-t / 0.1f));
+}
+
+// Keeps oscillating well outside the settle band
+static float ringing(float t)
+{
+    return 2.0f + 0.5f * cosf(2 * (float)M_PI * 3 * t);
+}
+
+// Knocked 3 degrees off and brought back
+static float impulse(float t)
+{
+    return 3.0f * (t / 0.05f) * expf(1 - t / 0.05f);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_baseline_is_mean_of_pre_step_samples()
+{
+    record(firstOrder, 2.0);
+    points[0].angle = BASE + 5;
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, BASE + 0.1, stepBaseline(points, PRE));
+    TEST_ASSERT_EQUAL_FLOAT(0, stepBaseline(points, 0));
+}
+
+void test_first_order_step()
+{
+    record(firstOrder, 2.0);
+    StepMetrics m;
+    computeStepMetrics(points, PRE + RUN, PRE, STEP_TARGET, 2.0, m);
+
+    // 10-90% rise of a first order lag is tau * ln 9, settling into 5% is tau * ln 20
+    // but the band is widened to 0.2 degrees (10%): tau * ln 10
+    TEST_ASSERT_FLOAT_WITHIN(TICK_US / 1e6, 0.1 * log(9.0), m.riseTime);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, 0.0, m.overshoot);
+    TEST_ASSERT_FLOAT_WITHIN(TICK_US / 1e6, 0.1 * log(10.0), m.settlingTime);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, 0.0, m.steadyStateError);
+    // Integral of 2 e^(-t / tau)
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 0.2, m.iae);
+}
+
+void test_underdamped_overshoot()
+{
+    record(underdamped, 2.0);
+    StepMetrics m;
+    computeStepMetrics(points, PRE + RUN, PRE, STEP_TARGET, 2.0, m);
+    TEST_ASSERT_FLOAT_WITHIN(0.3, 16.3, m.overshoot);
+    TEST_ASSERT_TRUE(m.riseTime > 0 && m.riseTime < 0.15);
+    TEST_ASSERT_TRUE(m.settlingTime > m.riseTime && m.settlingTime < 1.0);
+}
+
+void test_negative_step_is_normalized()
+{
+    record(underdamped, 2.0);
+    for (int i = PRE; i < PRE + RUN; i++)
+    {
+        points[i].angle = 2 * BASE - points[i].angle;
+        points[i].setpoint = BASE - 2.0;
+    }
+    StepMetrics m;
+    computeStepMetrics(points, PRE + RUN, PRE, STEP_TARGET, -2.0, m);
+    TEST_ASSERT_FLOAT_WITHIN(0.3, 16.3, m.overshoot);
+    TEST_ASSERT_TRUE(m.riseTime > 0);
+}
+
+void test_steady_state_error()
+{
+    record(offsetResponse, 2.0);
+    StepMetrics m;
+    computeStepMetrics(points, PRE + RUN, PRE, STEP_TARGET, 2.0, m);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, 0.5, m.steadyStateError);
+    // Never reaches 90% of the step, and ends outside the band
+    TEST_ASSERT_EQUAL_FLOAT(-1, m.riseTime);
+    TEST_ASSERT_EQUAL_FLOAT(-1, m.settlingTime);
+}
+
+void test_never_settles()
+{
+    record(ringing, 2.0);
+    StepMetrics m;
+    computeStepMetrics(points, PRE + RUN, PRE, STEP_TARGET, 2.0, m);
+    TEST_ASSERT_EQUAL_FLOAT(-1, m.settlingTime);
+    TEST_ASSERT_FLOAT_WITHIN(0.5, 25.0, m.overshoot);
+}
+
+void test_impulse_reports_peak_deviation()
+{
+    record(impulse, 0.0);
+    StepMetrics m;
+    computeStepMetrics(points, PRE + RUN, PRE, STEP_IMPULSE, 30.0, m);
+    TEST_ASSERT_EQUAL_FLOAT(-1, m.riseTime);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 3.0, m.overshoot);
+    TEST_ASSERT_TRUE(m.settlingTime > 0.05 && m.settlingTime < 1.0);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, 0.0, m.steadyStateError);
+}
+
+void test_no_response_samples()
+{
+    record(firstOrder, 2.0);
+    StepMetrics m;
+    computeStepMetrics(points, PRE, PRE, STEP_TARGET, 2.0, m);
+    TEST_ASSERT_EQUAL_FLOAT(-1, m.riseTime);
+    TEST_ASSERT_EQUAL_FLOAT(0, m.iae);
+    TEST_ASSERT_EQUAL_FLOAT(0, m.steadyStateError);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_baseline_is_mean_of_pre_step_samples);
+    RUN_TEST(test_first_order_step);
+    RUN_TEST(test_underdamped_overshoot);
+    RUN_TEST(test_negative_step_is_normalized);
+    RUN_TEST(test_steady_state_error);
+    RUN_TEST(test_never_settles);
+    RUN_TEST(test_impulse_reports_peak_deviation);
+    RUN_TEST(test_no_response_samples);
+    return UNITY_END();
+}
@@ -0,0 +1,140 @@
+// Acceleration-limited setpoint profile (control/trajectory)
+
+#include <unity.h>
+#include "control/trajectory.h"
+
+const float DT = 0.005; // 200 Hz control tick
+
+// Run until the profile settles on its target, returns the number of ticks
+static int runToTarget(SetpointProfile &profile, float target, int maxTicks)
+{
+    for (int i = 1; i <= maxTicks; i++)
+    {
+        updateProfile(profile, target, DT);
+        if (profile.value == target && profile.velocity == 0)
+            return i;
+    }
+    return -1;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_step_up_respects_limits_and_lands()
+{
+    SetpointProfile profile;
+    initProfile(profile, 0.0, 10.0, 40.0);
+
+    float lastValue = 0.0, lastVelocity = 0.0, peakVelocity = 0.0;
+    int ticks = 0;
+    while (!(profile.value == 5.0 && profile.velocity == 0) && ticks < 1000)
+    {
+        updateProfile(profile, 5.0, DT);
+        ticks++;
+
+        // Monotonic, no overshoot beyond float rounding, within both limits
+        TEST_ASSERT_TRUE(profile.value >= lastValue - 1e-4);
+        TEST_ASSERT_TRUE(profile.value <= 5.0 + 1e-4);
+        TEST_ASSERT_TRUE(profile.velocity <= 10.0 + 1e-4);
+        TEST_ASSERT_TRUE(abs(profile.velocity - lastVelocity) <= 40.0 * DT + 1e-4);
+        lastValue = profile.value;
+        lastVelocity = profile.velocity;
+        peakVelocity = max(peakVelocity, profile.velocity);
+    }
+
+    TEST_ASSERT_EQUAL_FLOAT(5.0, profile.value);
+    TEST_ASSERT_EQUAL_FLOAT(5.0, profile.target);
+    // Long enough to reach the rate limit: 0.25 s each way plus 0.25 s cruising
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, 10.0, peakVelocity);
+    TEST_ASSERT_TRUE(ticks > 140 && ticks < 170);
+}
+
+void test_step_down_mirrors_step_up()
+{
+    SetpointProfile up, down;
+    initProfile(up, 0.0, 10.0, 40.0);
+    initProfile(down, 0.0, 10.0, 40.0);
+
+    for (int i = 0; i < 60; i++)
+    {
+        updateProfile(up, 2.0, DT);
+        updateProfile(down, -2.0, DT);
+        TEST_ASSERT_FLOAT_WITHIN(1e-5, -up.value, down.value);
+        TEST_ASSERT_FLOAT_WITHIN(1e-5, -up.velocity, down.velocity);
+        TEST_ASSERT_TRUE(down.value >= -2.0);
+    }
+    TEST_ASSERT_TRUE(runToTarget(down, -2.0, 1000) >= 0);
+    TEST_ASSERT_EQUAL_FLOAT(-2.0, down.value);
+}
+
+void test_target_change_mid_ramp_keeps_velocity_continuous()
+{
+    SetpointProfile profile;
+    initProfile(profile, 0.0, 10.0, 40.0);
+
+    // Accelerate towards 5, then reverse the request while still moving up
+    for (int i = 0; i < 40; i++)
+        updateProfile(profile, 5.0, DT);
+    TEST_ASSERT_TRUE(profile.velocity > 5.0);
+
+    float lastVelocity = profile.velocity;
+    float peakValue = profile.value;
+    for (int i = 0; i < 1000 && !(profile.value == -1.0 && profile.velocity == 0); i++)
+    {
+        updateProfile(profile, -1.0, DT);
+        TEST_ASSERT_TRUE(abs(profile.velocity - lastVelocity) <= 40.0 * DT + 1e-4);
+        lastVelocity = profile.velocity;
+        peakValue = max(peakValue, profile.value);
+    }
+
+    // It had to brake before turning round, so it carried on past the reversal point
+    TEST_ASSERT_TRUE(peakValue > 1.5);
+    TEST_ASSERT_EQUAL_FLOAT(-1.0, profile.value);
+    TEST_ASSERT_EQUAL_FLOAT(0.0, profile.velocity);
+}
+
+void test_non_positive_dt_holds_value()
+{
+    SetpointProfile profile;
+    initProfile(profile, 1.0, 10.0, 40.0);
+    for (int i = 0; i < 10; i++)
+        updateProfile(profile, 3.0, DT);
+    float value = profile.value;
+    float velocity = profile.velocity;
+
+    TEST_ASSERT_EQUAL_FLOAT(value, updateProfile(profile, 3.0, 0.0));
+    TEST_ASSERT_EQUAL_FLOAT(value, updateProfile(profile, 3.0, -DT));
+    TEST_ASSERT_EQUAL_FLOAT(velocity, profile.velocity);
+    // The new target is still recorded
+    updateProfile(profile, 4.0, 0.0);
+    TEST_ASSERT_EQUAL_FLOAT(4.0, profile.target);
+}
+
+void test_reset_stops_motion()
+{
+    SetpointProfile profile;
+    initProfile(profile, 0.0, 10.0, 40.0);
+    for (int i = 0; i < 10; i++)
+        updateProfile(profile, 5.0, DT);
+    resetProfile(profile, 2.0);
+    TEST_ASSERT_EQUAL_FLOAT(2.0, profile.value);
+    TEST_ASSERT_EQUAL_FLOAT(2.0, profile.target);
+    TEST_ASSERT_EQUAL_FLOAT(0.0, profile.velocity);
+    TEST_ASSERT_EQUAL_INT(1, runToTarget(profile, 2.0, 10));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_step_up_respects_limits_and_lands);
+    RUN_TEST(test_step_down_mirrors_step_up);
+    RUN_TEST(test_target_change_mid_ramp_keeps_velocity_continuous);
+    RUN_TEST(test_non_positive_dt_holds_value);
+    RUN_TEST(test_reset_stops_motion);
+    return UNITY_END();
+}
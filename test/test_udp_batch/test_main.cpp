@@ -0,0 +1,259 @@
+// UDP telemetry batches: sender packing, receiver validation and loss accounting
+// (telemetry/udp_batch), round-tripped through a byte buffer as on the wire
+
+#include <unity.h>
+#include <string.h>
+#include "telemetry/udp_batch.h"
+
+static UdpBatch batch;
+static uint8_t wire[sizeof(UdpBatch) + sizeof(ControlSample)];
+
+// A full batch starting at firstSample, as udpSinkSample() fills it
+static size_t sendBatch(uint32_t sequence, uint32_t firstSample, uint32_t senderDropped)
+{
+    startUdpBatch(batch, firstSample, 1);
+    ControlSample s;
+    memset(&s, 0, sizeof(s));
+    uint32_t index = firstSample;
+    do
+    {
+        s.timeUs = index * 5000;
+        s.angle = 87.0f + index * 0.01f;
+        s.flags = SAMPLE_ARMED;
+        index++;
+    } while (!addUdpSample(batch, s));
+    batch.header.sequence = sequence;
+    batch.header.senderDropped = senderDropped;
+
+    size_t len = udpBatchSize(batch);
+    memcpy(wire, &batch, len);
+    return len;
+}
+
+static int receive(size_t len, UdpBatchHeader &header, const ControlSample **samples)
+{
+    return parseUdpBatch(wire, len, header, samples);
+}
+
+void setUp()
+{
+    memset(wire, 0, sizeof(wire));
+}
+
+void tearDown()
+{
+}
+
+void test_full_batch_round_trips()
+{
+    size_t len = sendBatch(7, 1000, 2);
+    TEST_ASSERT_EQUAL_INT(sizeof(UdpBatchHeader) + UDP_BATCH_SAMPLES * sizeof(ControlSample), len);
+    TEST_ASSERT_TRUE(len <= 1472); // One datagram in a 1500-byte MTU
+
+    UdpBatchHeader header;
+    const ControlSample *samples = NULL;
+    TEST_ASSERT_EQUAL_INT(UDP_BATCH_SAMPLES, receive(len, header, &samples));
+    TEST_ASSERT_EQUAL_UINT32(7, header.sequence);
+    TEST_ASSERT_EQUAL_UINT32(1000, header.firstSample);
+    TEST_ASSERT_EQUAL_UINT32(2, header.senderDropped);
+    TEST_ASSERT_EQUAL_INT(1, header.decimation);
+    TEST_ASSERT_TRUE(samples == (const ControlSample *)(wire + sizeof(UdpBatchHeader)));
+
+    ControlSample last;
+    memcpy(&last, &samples[UDP_BATCH_SAMPLES - 1], sizeof(last));
+    TEST_ASSERT_EQUAL_UINT32((1000 + UDP_BATCH_SAMPLES - 1) * 5000, last.timeUs);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 87.0f + (1000 + UDP_BATCH_SAMPLES - 1) * 0.01f, last.angle);
+}
+
+void test_partial_batch_round_trips()
+{
+    startUdpBatch(batch, 5, 4);
+    ControlSample s;
+    memset(&s, 0, sizeof(s));
+    TEST_ASSERT_FALSE(addUdpSample(batch, s));
+    TEST_ASSERT_FALSE(addUdpSample(batch, s));
+    size_t len = udpBatchSize(batch);
+    memcpy(wire, &batch, len);
+
+    UdpBatchHeader header;
+    const ControlSample *samples;
+    TEST_ASSERT_EQUAL_INT(2, receive(len, header, &samples));
+    TEST_ASSERT_EQUAL_INT(4, header.decimation);
+
+    // An empty batch is still a valid datagram
+    startUdpBatch(batch, 5, 1);
+    memcpy(wire, &batch, udpBatchSize(batch));
+    TEST_ASSERT_EQUAL_INT(0, receive(sizeof(UdpBatchHeader), header, &samples));
+}
+
+void test_full_batch_ignores_extra_samples()
+{
+    sendBatch(0, 0, 0);
+    ControlSample s;
+    memset(&s, 0, sizeof(s));
+    TEST_ASSERT_TRUE(addUdpSample(batch, s));
+    TEST_ASSERT_EQUAL_INT(UDP_BATCH_SAMPLES, batch.header.count);
+}
+
+void test_short_and_truncated_datagrams_are_rejected()
+{
+    size_t len = sendBatch(1, 0, 0);
+    UdpBatchHeader header;
+    const ControlSample *samples;
+
+    TEST_ASSERT_EQUAL_INT(-1, receive(0, header, &samples));
+    TEST_ASSERT_EQUAL_INT(-1, receive(sizeof(UdpBatchHeader) - 1, header, &samples));
+    TEST_ASSERT_EQUAL_INT(-1, receive(sizeof(UdpBatchHeader), header, &samples));
+    TEST_ASSERT_EQUAL_INT(-1, receive(len - 1, header, &samples));
+    TEST_ASSERT_EQUAL_INT(-1, receive(len - sizeof(ControlSample), header, &samples));
+    TEST_ASSERT_EQUAL_INT(-1, receive(len + 1, header, &samples));
+}
+
+void test_foreign_datagrams_are_rejected()
+{
+    UdpBatchHeader header;
+    const ControlSample *samples;
+    size_t len = sendBatch(1, 0, 0);
+    UdpBatchHeader *h = (UdpBatchHeader *)wire;
+
+    h->magic ^= 1;
+    TEST_ASSERT_EQUAL_INT(-1, receive(len, header, &samples));
+    h->magic = UDP_BATCH_MAGIC;
+
+    h->version = UDP_BATCH_VERSION + 1;
+    TEST_ASSERT_EQUAL_INT(-1, receive(len, header, &samples));
+    h->version = UDP_BATCH_VERSION;
+
+    h->sampleSize = sizeof(ControlSample) + 4;
+    TEST_ASSERT_EQUAL_INT(-1, receive(len, header, &samples));
+    h->sampleSize = sizeof(ControlSample);
+
+    // A count past the batch limit, even with a matching length
+    h->count = UDP_BATCH_SAMPLES + 1;
+    TEST_ASSERT_EQUAL_INT(-1, receive(len + sizeof(ControlSample), header, &samples));
+    h->count = UDP_BATCH_SAMPLES;
+
+    TEST_ASSERT_EQUAL_INT(UDP_BATCH_SAMPLES, receive(len, header, &samples));
+}
+
+// Send, "lose" some datagrams, and account for what arrives
+static bool deliver(UdpLossStats &stats, uint32_t sequence, uint32_t firstSample, uint32_t senderDropped)
+{
+    size_t len = sendBatch(sequence, firstSample, senderDropped);
+    UdpBatchHeader header;
+    const ControlSample *samples;
+    if (receive(len, header, &samples) < 0)
+    {
+        stats.invalid++;
+        return false;
+    }
+    return accountUdpBatch(stats, header);
+}
+
+void test_in_order_stream_has_no_losses()
+{
+    UdpLossStats stats;
+    memset(&stats, 0, sizeof(stats));
+    for (uint32_t i = 0; i < 10; i++)
+        TEST_ASSERT_TRUE(deliver(stats, 100 + i, 5000 + i * UDP_BATCH_SAMPLES, 0));
+
+    TEST_ASSERT_EQUAL_UINT32(10, stats.datagrams);
+    TEST_ASSERT_EQUAL_UINT32(10 * UDP_BATCH_SAMPLES, stats.samples);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.lostDatagrams);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.lostSamples);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.late);
+}
+
+void test_network_loss_counts_datagrams_and_samples()
+{
+    UdpLossStats stats;
+    memset(&stats, 0, sizeof(stats));
+    for (uint32_t i = 0; i < 20; i++)
+    {
+        if (i % 5 == 4)
+            continue; // Lost on the network: sequence and samples both skip
+        deliver(stats, i, i * UDP_BATCH_SAMPLES, 0);
+    }
+
+    // Datagrams 4, 9 and 14 are seen as gaps; 19 was the last one and is not
+    TEST_ASSERT_EQUAL_UINT32(16, stats.datagrams);
+    TEST_ASSERT_EQUAL_UINT32(3, stats.lostDatagrams);
+    TEST_ASSERT_EQUAL_UINT32(3 * UDP_BATCH_SAMPLES, stats.lostSamples);
+}
+
+void test_sender_drops_skip_samples_not_sequence()
+{
+    // The robot could not send one batch: the sequence is continuous but a
+    // batch worth of samples is missing, and the robot reports the drop
+    UdpLossStats stats;
+    memset(&stats, 0, sizeof(stats));
+    deliver(stats, 0, 0, 0);
+    deliver(stats, 1, 2 * UDP_BATCH_SAMPLES, 1);
+
+    TEST_ASSERT_EQUAL_UINT32(0, stats.lostDatagrams);
+    TEST_ASSERT_EQUAL_UINT32(UDP_BATCH_SAMPLES, stats.lostSamples);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.senderDropped);
+}
+
+void test_late_and_duplicate_datagrams_are_not_kept()
+{
+    UdpLossStats stats;
+    memset(&stats, 0, sizeof(stats));
+    TEST_ASSERT_TRUE(deliver(stats, 0, 0, 0));
+    TEST_ASSERT_TRUE(deliver(stats, 2, 2 * UDP_BATCH_SAMPLES, 0));
+    TEST_ASSERT_FALSE(deliver(stats, 1, UDP_BATCH_SAMPLES, 0)); // Reordered
+    TEST_ASSERT_FALSE(deliver(stats, 2, 2 * UDP_BATCH_SAMPLES, 0)); // Duplicated
+
+    TEST_ASSERT_EQUAL_UINT32(2, stats.late);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.datagrams);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.lostDatagrams);
+    TEST_ASSERT_EQUAL_UINT32(3, stats.nextSequence);
+}
+
+void test_counters_wrap()
+{
+    UdpLossStats stats;
+    memset(&stats, 0, sizeof(stats));
+    uint32_t sample = 0xFFFFFFFFu - UDP_BATCH_SAMPLES;
+    TEST_ASSERT_TRUE(deliver(stats, 0xFFFFFFFFu, sample, 0));
+    TEST_ASSERT_TRUE(deliver(stats, 0, sample + UDP_BATCH_SAMPLES, 0));
+    TEST_ASSERT_TRUE(deliver(stats, 2, sample + 3 * UDP_BATCH_SAMPLES, 0));
+
+    TEST_ASSERT_EQUAL_UINT32(0, stats.late);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.lostDatagrams);
+    TEST_ASSERT_EQUAL_UINT32(UDP_BATCH_SAMPLES, stats.lostSamples);
+}
+
+void test_invalid_datagram_leaves_accounting_alone()
+{
+    UdpLossStats stats;
+    memset(&stats, 0, sizeof(stats));
+    deliver(stats, 0, 0, 0);
+
+    UdpBatchHeader header;
+    const ControlSample *samples;
+    size_t len = sendBatch(1, UDP_BATCH_SAMPLES, 0);
+    if (receive(len - 3, header, &samples) < 0)
+        stats.invalid++;
+
+    TEST_ASSERT_EQUAL_UINT32(1, stats.invalid);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.datagrams);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.nextSequence);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_full_batch_round_trips);
+    RUN_TEST(test_partial_batch_round_trips);
+    RUN_TEST(test_full_batch_ignores_extra_samples);
+    RUN_TEST(test_short_and_truncated_datagrams_are_rejected);
+    RUN_TEST(test_foreign_datagrams_are_rejected);
+    RUN_TEST(test_in_order_stream_has_no_losses);
+    RUN_TEST(test_network_loss_counts_datagrams_and_samples);
+    RUN_TEST(test_sender_drops_skip_samples_not_sequence);
+    RUN_TEST(test_late_and_duplicate_datagrams_are_not_kept);
+    RUN_TEST(test_counters_wrap);
+    RUN_TEST(test_invalid_datagram_leaves_accounting_alone);
+    return UNITY_END();
+}
@@ -0,0 +1,231 @@
+// Replay recorded IMU samples through the firmware tilt estimator and
+// alternative estimators on the host.
+//
+// Input: a capture download (GET /capture?format=bin) or a black-box
+// recording (GET /blackbox?file=fall-NNNN.bin). Records are streamed one at a
+// time, so recordings of any length work in constant memory.
+//
+// Build from the repository root (no FMA contraction, so float results match
+// the firmware build of src/gyro/estimator.cpp operation for operation):
+//   g++ -std=c++11 -O2 -ffp-contract=off -Isrc tools/imu_replay/imu_replay.cpp src/gyro/estimator.cpp -o imu_replay
+//
+// Usage: imu_replay <recording.bin> [out.csv]
+// Writes time_us, recorded angle and one column per estimator, and prints
+// per-estimator timing plus the deviation of the firmware estimator from the
+// angle recorded on the robot.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include "gyro/estimator.h"
+
+// Record layouts, mirrored from src/telemetry/capture.h and blackbox.h
+struct __attribute__((packed)) ControlSample
+{
+    uint32_t timeUs;
+    int16_t gyro[3];
+    int16_t accel[3];
+    float angle;
+    float setpoint;
+    float pTerm;
+    float iTerm;
+    float dTerm;
+    int8_t leftDuty;
+    int8_t rightDuty;
+    uint8_t flags;
+    uint8_t reserved;
+};
+
+static_assert(sizeof(ControlSample) == 40, "ControlSample layout changed, update the replay tool");
+
+const uint32_t CAPTURE_MAGIC = 0x54504143;  // "CAPT", 16-byte header
+const uint32_t BLACKBOX_MAGIC = 0x584F4242; // "BBOX", 28-byte header
+
+// Alternative: angle/gyro-bias Kalman filter on the same inputs
+struct KalmanEstimator
+{
+    float angle;
+    float bias;
+    float p[2][2];
+    uint32_t lastTimeUs;
+};
+
+const float KALMAN_Q_ANGLE = 0.001f;
+const float KALMAN_Q_BIAS = 0.003f;
+const float KALMAN_R_MEASURE = 0.03f;
+
+static void resetKalman(KalmanEstimator &k, float angle, uint32_t timeUs)
+{
+    k.angle = angle;
+    k.bias = 0;
+    k.p[0][0] = k.p[0][1] = k.p[1][0] = k.p[1][1] = 0;
+    k.lastTimeUs = timeUs;
+}
+
+static float updateKalman(KalmanEstimator &k, const ImuSample &s)
+{
+    float dt = (uint32_t)(s.timeUs - k.lastTimeUs) / 1000000.0f;
+    k.lastTimeUs = s.timeUs;
+
+    float rate = -(s.gyro[1] / GYRO_COUNTS_PER_DPS) - k.bias;
+    k.angle += dt * rate;
+    k.p[0][0] += dt * (dt * k.p[1][1] - k.p[0][1] - k.p[1][0] + KALMAN_Q_ANGLE);
+    k.p[0][1] -= dt * k.p[1][1];
+    k.p[1][0] -= dt * k.p[1][1];
+    k.p[1][1] += KALMAN_Q_BIAS * dt;
+
+    // Measurement: accelerometer tilt, kept on the same side of the wrap as the estimate
+    float measured = accelTiltAngle(s);
+    float innovation = measured - k.angle;
+    if (innovation > 180.0f)
+        innovation -= 360.0f;
+    else if (innovation < -180.0f)
+        innovation += 360.0f;
+
+    float sGain = k.p[0][0] + KALMAN_R_MEASURE;
+    float k0 = k.p[0][0] / sGain;
+    float k1 = k.p[1][0] / sGain;
+    k.angle += k0 * innovation;
+    k.bias += k1 * innovation;
+    float p00 = k.p[0][0], p01 = k.p[0][1];
+    k.p[0][0] -= k0 * p00;
+    k.p[0][1] -= k0 * p01;
+    k.p[1][0] -= k1 * p00;
+    k.p[1][1] -= k1 * p01;
+
+    k.angle = fmodf(k.angle + 360.0f, 360.0f);
+    return k.angle;
+}
+
+struct Timing
+{
+    double totalNs;
+    double maxNs;
+};
+
+static void addTiming(Timing &t, std::chrono::steady_clock::time_point start)
+{
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    t.totalNs += ns;
+    if (ns > t.maxNs)
+        t.maxNs = ns;
+}
+
+static ImuSample toImuSample(const ControlSample &c)
+{
+    ImuSample s;
+    s.timeUs = c.timeUs;
+    memcpy(s.gyro, c.gyro, sizeof(s.gyro));
+    memcpy(s.accel, c.accel, sizeof(s.accel));
+    return s;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <recording.bin> [out.csv]\n", argv[0]);
+        return 2;
+    }
+
+    FILE *in = fopen(argv[1], "rb");
+    if (!in)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    FILE *out = argc > 2 ? fopen(argv[2], "w") : stdout;
+    if (!out)
+    {
+        perror(argv[2]);
+        return 1;
+    }
+
+    // Both headers start with magic, version, sample size, count
+    uint8_t header[28];
+    if (fread(header, 1, 8, in) != 8)
+    {
+        fprintf(stderr, "%s: truncated header\n", argv[1]);
+        return 1;
+    }
+    uint32_t magic;
+    uint16_t sampleSize;
+    memcpy(&magic, header, 4);
+    memcpy(&sampleSize, header + 6, 2);
+    size_t headerSize = magic == CAPTURE_MAGIC ? 16 : magic == BLACKBOX_MAGIC ? 28 : 0;
+    if (headerSize == 0 || sampleSize != sizeof(ControlSample))
+    {
+        fprintf(stderr, "%s: not a capture or black-box recording (magic %08x, sample size %u)\n",
+                argv[1], (unsigned)magic, (unsigned)sampleSize);
+        return 1;
+    }
+    if (fread(header + 8, 1, headerSize - 8, in) != headerSize - 8)
+    {
+        fprintf(stderr, "%s: truncated header\n", argv[1]);
+        return 1;
+    }
+
+    fprintf(out, "time_us,recorded,complementary,kalman\n");
+
+    AngleEstimator complementary;
+    KalmanEstimator kalman;
+    Timing complementaryTime = {0, 0};
+    Timing kalmanTime = {0, 0};
+    uint32_t samples = 0;
+    uint32_t exact = 0;
+    float maxDiff = 0;
+    uint32_t firstUs = 0, lastUs = 0;
+
+    ControlSample record;
+    while (fread(&record, sizeof(record), 1, in) == 1)
+    {
+        ImuSample s = toImuSample(record);
+        if (samples == 0)
+        {
+            // Start from the robot's own estimate so the traces can be compared tick by tick
+            complementary.angle = record.angle;
+            complementary.lastTimeUs = s.timeUs;
+            resetKalman(kalman, record.angle, s.timeUs);
+            firstUs = s.timeUs;
+            fprintf(out, "%lu,%.9g,%.9g,%.9g\n", (unsigned long)s.timeUs, record.angle, record.angle, record.angle);
+            samples++;
+            continue;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        float c = updateAngleEstimator(complementary, s);
+        addTiming(complementaryTime, start);
+
+        start = std::chrono::steady_clock::now();
+        float k = updateKalman(kalman, s);
+        addTiming(kalmanTime, start);
+
+        if (memcmp(&c, &record.angle, sizeof(float)) == 0)
+            exact++;
+        float diff = fabsf(c - record.angle);
+        if (diff > maxDiff)
+            maxDiff = diff;
+
+        fprintf(out, "%lu,%.9g,%.9g,%.9g\n", (unsigned long)s.timeUs, record.angle, c, k);
+        lastUs = s.timeUs;
+        samples++;
+    }
+    fclose(in);
+    if (out != stdout)
+        fclose(out);
+
+    if (samples < 2)
+    {
+        fprintf(stderr, "%u samples, nothing to replay\n", (unsigned)samples);
+        return 1;
+    }
+    uint32_t updates = samples - 1;
+    fprintf(stderr, "%u samples over %.3f s\n", (unsigned)samples, (uint32_t)(lastUs - firstUs) / 1e6);
+    fprintf(stderr, "complementary vs recorded: %u/%u bit-identical, max |diff| %.9g deg\n",
+            (unsigned)exact, (unsigned)updates, maxDiff);
+    fprintf(stderr, "complementary: %.1f ns/update (max %.0f)\n", complementaryTime.totalNs / updates, complementaryTime.maxNs);
+    fprintf(stderr, "kalman:        %.1f ns/update (max %.0f)\n", kalmanTime.totalNs / updates, kalmanTime.maxNs);
+    return 0;
+}
@@ -0,0 +1,202 @@
+// Host side of the UDP telemetry sink (src/telemetry/udp_sink.h).
+//
+// receive: listens for batches, writes the samples as a capture recording
+// (same format as GET /capture?format=bin, so tools/imu_replay reads it) and
+// reports lost datagrams and samples as they happen.
+//
+// send: streams synthetic samples through the firmware batch code, skipping
+// every Nth datagram, to test a receiver over loopback without a robot.
+//
+// Build from the repository root:
+//   g++ -std=c++11 -O2 -Isrc tools/udp_telemetry/udp_telemetry.cpp src/telemetry/udp_batch.cpp -o udp_telemetry
+//
+// Usage:
+//   udp_telemetry receive <port> <out.bin> [idle-seconds]
+//   udp_telemetry send <host> <port> <batches> [drop-every]
+// Configure the robot with: curl -d host=<pc ip> -d port=<port> -d enable=1 http://<robot>/udp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "telemetry/udp_batch.h"
+
+// Capture file header, mirrored from src/telemetry/capture.h
+struct __attribute__((packed)) CaptureHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t sampleSize;
+    uint32_t count;
+    uint32_t triggerIndex;
+};
+
+const uint32_t CAPTURE_MAGIC = 0x54504143; // "CAPT"
+const uint32_t CAPTURE_NO_TRIGGER = 0xFFFFFFFF;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int)
+{
+    stopRequested = 1;
+}
+
+// Shared accounting, plus a line per gap as it happens
+static bool accountBatch(UdpLossStats &s, const UdpBatchHeader &h)
+{
+    UdpLossStats before = s;
+    if (!accountUdpBatch(s, h))
+        return false;
+
+    if (s.lostDatagrams != before.lostDatagrams)
+        fprintf(stderr, "gap: datagrams %u-%u lost\n", (unsigned)before.nextSequence, (unsigned)(h.sequence - 1));
+    if (s.lostSamples != before.lostSamples)
+        fprintf(stderr, "gap: samples %u-%u missing (%u)\n", (unsigned)before.nextSample, (unsigned)(h.firstSample - 1),
+                (unsigned)(s.lostSamples - before.lostSamples));
+    return true;
+}
+
+static int receive(int port, const char *path, int idleSeconds)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0)
+    {
+        perror("socket");
+        return 1;
+    }
+    int bufferSize = 1 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(sock, (sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("bind");
+        return 1;
+    }
+
+    // Wake up once a second to check for Ctrl-C and the idle timeout
+    timeval timeout = {1, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    FILE *out = fopen(path, "wb");
+    if (!out)
+    {
+        perror(path);
+        return 1;
+    }
+    // Count is filled in on exit
+    CaptureHeader header = {CAPTURE_MAGIC, 1, sizeof(ControlSample), 0, CAPTURE_NO_TRIGGER};
+    fwrite(&header, sizeof(header), 1, out);
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    fprintf(stderr, "listening on udp port %d, writing %s\n", port, path);
+
+    UdpLossStats stats;
+    memset(&stats, 0, sizeof(stats));
+    int idle = 0;
+    uint8_t datagram[2048];
+    while (!stopRequested)
+    {
+        ssize_t len = recv(sock, datagram, sizeof(datagram), 0);
+        if (len < 0)
+        {
+            if (idleSeconds > 0 && stats.started && ++idle >= idleSeconds)
+                break;
+            continue;
+        }
+        idle = 0;
+
+        UdpBatchHeader batch;
+        const ControlSample *samples;
+        int count = parseUdpBatch(datagram, len, batch, &samples);
+        if (count < 0)
+        {
+            stats.invalid++;
+            continue;
+        }
+        if (accountBatch(stats, batch))
+            fwrite(samples, sizeof(ControlSample), count, out);
+    }
+
+    header.count = stats.samples;
+    fseek(out, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, out);
+    fclose(out);
+    close(sock);
+
+    uint32_t expected = stats.datagrams + stats.lostDatagrams;
+    fprintf(stderr, "%u datagrams, %u samples written\n", (unsigned)stats.datagrams, (unsigned)stats.samples);
+    fprintf(stderr, "lost: %u datagrams (%.2f%%), %u samples; sender dropped %u batches; %u late, %u invalid\n",
+            (unsigned)stats.lostDatagrams, expected ? 100.0 * stats.lostDatagrams / expected : 0.0,
+            (unsigned)stats.lostSamples, (unsigned)stats.senderDropped, (unsigned)stats.late, (unsigned)stats.invalid);
+    return 0;
+}
+
+// Synthetic ticks at 200 Hz, batched exactly like udpSinkSample()
+static int send(const char *host, int port, int batches, int dropEvery)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (sock < 0 || inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+    {
+        fprintf(stderr, "bad host %s\n", host);
+        return 1;
+    }
+
+    UdpBatch batch;
+    uint32_t sample = 0;
+    uint32_t sequence = 0;
+    int skipped = 0;
+    for (int b = 0; b < batches; b++)
+    {
+        startUdpBatch(batch, sample, 1);
+        ControlSample s;
+        memset(&s, 0, sizeof(s));
+        do
+        {
+            s.timeUs = sample * 5000;
+            s.angle = 87.0f + (sample % 100) * 0.01f;
+            s.setpoint = 87.0f;
+            s.flags = SAMPLE_ARMED;
+            sample++;
+        } while (!addUdpSample(batch, s));
+
+        batch.header.sequence = sequence++;
+        if (dropEvery > 0 && (b + 1) % dropEvery == 0)
+        {
+            skipped++;
+            continue; // Lost on the "network"
+        }
+        if (sendto(sock, &batch, udpBatchSize(batch), 0, (sockaddr *)&addr, sizeof(addr)) < 0)
+            perror("sendto");
+        usleep(1000);
+    }
+    close(sock);
+    fprintf(stderr, "sent %d of %d datagrams (%u samples generated)\n", batches - skipped, batches, (unsigned)sample);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 4 && strcmp(argv[1], "receive") == 0)
+        return receive(atoi(argv[2]), argv[3], argc > 4 ? atoi(argv[4]) : 0);
+    if (argc >= 5 && strcmp(argv[1], "send") == 0)
+        return send(argv[2], atoi(argv[3]), atoi(argv[4]), argc > 5 ? atoi(argv[5]) : 0);
+
+    fprintf(stderr, "usage: %s receive <port> <out.bin> [idle-seconds]\n", argv[0]);
+    fprintf(stderr, "       %s send <host> <port> <batches> [drop-every]\n", argv[0]);
+    return 2;
+}